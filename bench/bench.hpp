@@ -0,0 +1,47 @@
+#pragma once
+
+// Helpers shared by the benchmarks in bench/, built with cmake -DBUILD_BENCHMARKS=ON
+
+// internal
+#include "tiny_ecs_registry.hpp"
+#include "world_init.hpp"
+#include "contact_stream.hpp"
+
+// stlib
+#include <chrono>
+
+// Milliseconds per call of run, averaged over count calls
+template <typename Run>
+double bench_ms(int count, Run run)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; i++)
+		run();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+// A rectangle body with a motion, as the game creates them
+inline Entity bench_box(vec2 center, float w, float h, bool moveable)
+{
+	Entity entity = Entity::create();
+	registry.motions.emplace(entity).position = center;
+	createNewRectangleTiedToEntity(entity, w, h, center, moveable, 1.f);
+	return entity;
+}
+
+// Empty pinball board with the player status and the flipper the solver expects
+inline void bench_clear_board()
+{
+	while (registry.physObjs.entities.size() > 0)
+		registry.remove_all_components_of(registry.physObjs.entities.back());
+	if (registry.pinballPlayerStatus.size() == 0)
+		registry.pinballPlayerStatus.emplace(Entity::create());
+	registry.playerFlippers.emplace(bench_box({ 500.f, 720.f }, 100.f, 20.f, true));
+}
+
+// The contacts are consumed once per frame by the combat system in the game
+inline void bench_drop_contacts()
+{
+	pinball_contacts.clear();
+	pinball_floor_contacts.clear();
+}
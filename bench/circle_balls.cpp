@@ -0,0 +1,130 @@
+// Balls as circles against balls as the squares they used to be
+// Usage: circle_balls_bench [balls], defaults to 500
+// Times PhysicsSystem::step with a pile of balls built either way, then follows a single ball
+// launched at an enemy and one dropped onto a static box, to check the circle moves like the square.
+
+// internal
+#include "bench.hpp"
+#include "physics_system.hpp"
+
+// stlib
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+const float SIZE = 20.f;
+
+static Entity make_ball(vec2 center, bool circle)
+{
+	Entity entity = Entity::create();
+	registry.motions.emplace(entity).position = center;
+	registry.balls.emplace(entity);
+	if (circle)
+		createNewCircleTiedToEntity(entity, SIZE * 0.5f, center, true, 1.f);
+	else
+		createNewRectangleTiedToEntity(entity, SIZE, SIZE, center, true, 1.f);
+	return entity;
+}
+
+static void build_pile(int balls, bool circle)
+{
+	bench_clear_board();
+	bench_box({ 230.f, 400.f }, 20.f, 748.f, false);
+	bench_box({ 830.f, 400.f }, 20.f, 748.f, false);
+	srand(1);
+	for (int i = 0; i < balls; i++)
+		make_ball({ 250.f + rand() % 560, 50.f + rand() % 600 }, circle);
+}
+
+// Center of a ball every frame, for `frames` frames
+static std::vector<vec2> follow(Entity ball, int frames)
+{
+	PhysicsSystem physics;
+	physics.reset();
+	physics.set_solver_threads(1);
+	std::vector<vec2> path;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		physics.step(16.f);
+		bench_drop_contacts();
+		path.push_back(registry.physObjs.get(ball).center);
+	}
+	return path;
+}
+
+// A ball shot up at an enemy, until it is back where it started
+static std::vector<vec2> launched(bool circle)
+{
+	bench_clear_board();
+	registry.pinballEnemies.emplace(bench_box({ 560.f, 300.f }, 80.f, 20.f, false));
+	Entity ball = make_ball({ 540.f, 600.f }, circle);
+	physObj& obj = registry.physObjs.get(ball);
+	for (int i = 0; i < obj.VertexCount; i++)
+		obj.Vertices[i].oldPos = obj.Vertices[i].pos - vec2(0.05f, -1.f) * (1000.f / 360.f);
+	return follow(ball, 60);
+}
+
+// A ball dropped onto a static box, the highest point after the first bounce
+static float bounce_apex(bool circle)
+{
+	bench_clear_board();
+	bench_box({ 400.f, 500.f }, 200.f, 20.f, false);
+	Entity ball = make_ball({ 400.f, 200.f }, circle);
+	std::vector<vec2> path = follow(ball, 120);
+	size_t lowest = 0;
+	for (size_t i = 0; i < path.size(); i++)
+		if (path[i].y > path[lowest].y)
+			lowest = i;
+	float apex = path[lowest].y;
+	for (size_t i = lowest; i < path.size(); i++)
+		apex = std::min(apex, path[i].y);
+	return apex;
+}
+
+int main(int argc, char** argv)
+{
+	int balls = argc > 1 ? atoi(argv[1]) : 500;
+	const int SETTLE = 30;
+	const int FRAMES = 100;
+
+	printf("shape  ms/frame ms/substep\n");
+	for (int circle = 1; circle >= 0; circle--)
+	{
+		build_pile(balls, circle == 1);
+		PhysicsSystem physics;
+		physics.reset();
+		physics.set_solver_threads(1);
+		for (int frame = 0; frame < SETTLE; frame++)
+		{
+			physics.step(16.f);
+			bench_drop_contacts();
+		}
+
+		int substeps = 0;
+		double ms = bench_ms(FRAMES, [&] {
+			physics.step(16.f);
+			substeps += pinball_physics_stats.substeps;
+			bench_drop_contacts();
+		});
+		printf("%-6s %8.3f %10.3f\n", circle ? "circle" : "square", ms, ms * FRAMES / substeps);
+	}
+
+	// the paths of the launched ball, before and after it turns around at the enemy
+	std::vector<vec2> round = launched(true);
+	std::vector<vec2> square = launched(false);
+	float before = 0.f, after = 0.f;
+	bool hit = false;
+	for (size_t i = 0; i < round.size(); i++)
+	{
+		hit = hit || (i > 0 && round[i].y > round[i - 1].y);
+		float apart = length(round[i] - square[i]);
+		if (hit)
+			after = std::max(after, apart);
+		else
+			before = std::max(before, apart);
+	}
+	printf("launched ball apart: %.2f px on the way up, %.2f px after the hit\n", before, after);
+	printf("bounce apex: circle %.1f square %.1f\n", bounce_apex(true), bounce_apex(false));
+	return 0;
+}
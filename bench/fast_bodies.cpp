@@ -0,0 +1,72 @@
+// Fast balls against a thin wall, with and without the swept test
+// Usage: fast_bodies_bench [balls], defaults to 40
+// Fires a column of balls at 10x to 80x dash speed into a 20 px static wall and counts the ones that
+// end up behind it: with the ccd sweep and the substeps picked by speed, with the substeps alone, and
+// with neither at the fixed minimum of substeps. Also reports the substeps per frame and the time per frame.
+
+// internal
+#include "bench.hpp"
+#include "physics_system.hpp"
+
+// stlib
+#include <cstdio>
+#include <cstdlib>
+
+// px per ms of a dash, DASH_STRENTH pushed in at the 360 Hz step it was tuned for
+const float DASH_SPEED = 0.2f * 1000.f / 360.f;
+const float WALL_X = 600.f;
+
+static void build_board(int balls, float speed, bool ccd)
+{
+	bench_clear_board();
+	bench_box({ WALL_X, 400.f }, 20.f, 760.f, false);
+	for (int i = 0; i < balls; i++)
+	{
+		Entity entity = Entity::create();
+		vec2 center = { 300.f, 40.f + i * 600.f / balls };
+		registry.motions.emplace(entity).position = center;
+		registry.balls.emplace(entity);
+		createNewCircleTiedToEntity(entity, 8.f, center, true, 1.f);
+
+		// the Verlet velocity, measured over the step length PhysicsSystem::reset() starts from
+		physObj& obj = registry.physObjs.get(entity);
+		obj.ccd = ccd;
+		obj.Vertices[0].oldPos = center - vec2(speed, 0.f) * (1000.f / 360.f);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int balls = argc > 1 ? atoi(argv[1]) : 40;
+	const float MULTIPLES[] = { 10.f, 20.f, 40.f, 80.f };
+	const char* MODES[] = { "sweep", "substeps", "neither" };
+	const int FRAMES = 30;
+
+	printf("dash_x mode     tunnelled substeps/frame ms/frame\n");
+	for (float multiple : MULTIPLES)
+	{
+		for (int mode = 0; mode < 3; mode++)
+		{
+			build_board(balls, multiple * DASH_SPEED, mode == 0);
+			PhysicsSystem physics;
+			physics.reset();
+			physics.set_solver_threads(1);
+			if (mode == 2)
+				physics.max_substeps = physics.min_substeps;
+
+			int substeps = 0;
+			double ms = bench_ms(FRAMES, [&] {
+				physics.step(16.f);
+				substeps += pinball_physics_stats.substeps;
+				bench_drop_contacts();
+			});
+
+			int tunnelled = 0;
+			for (Entity entity : registry.balls.entities)
+				if (registry.physObjs.get(entity).Vertices[0].pos.x > WALL_X)
+					tunnelled++;
+			printf("%6.0f %-8s %6d/%-4d %13.1f %8.3f\n", multiple, MODES[mode], tunnelled, balls, (float)substeps / FRAMES, ms);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,73 @@
+// Pinball solver thread sweep
+// Usage: physics_threads_bench [bodies...], defaults to 500 2000 4000
+// Times PhysicsSystem::step for every thread count from 1 to the hardware threads. The position hash
+// must be the same for every thread count of a body count, the solver does not depend on it.
+
+// internal
+#include "bench.hpp"
+#include "physics_system.hpp"
+
+// stlib
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Fresh board: the flipper, two side walls, a row of enemies and bodies small boxes on a grid above
+// them, apart from each other so they start at rest
+static void build_board(int bodies)
+{
+	bench_clear_board();
+	bench_box({ 230.f, 400.f }, 20.f, 748.f, false);
+	bench_box({ 830.f, 400.f }, 20.f, 748.f, false);
+	for (int i = 0; i < 40; i++)
+		registry.pinballEnemies.emplace(bench_box({ 260.f + i * 13.f, 300.f + (i % 3) * 80.f }, 10.f, 8.f, false));
+
+	const int COLUMNS = 70;
+	for (int i = 0; i < bodies; i++)
+		bench_box({ 250.f + (i % COLUMNS) * 8.f, 20.f + (i / COLUMNS) * 8.f }, 6.f, 6.f, true);
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<int> sizes;
+	for (int i = 1; i < argc; i++)
+		sizes.push_back(atoi(argv[i]));
+	if (sizes.empty())
+		sizes = { 500, 2000, 4000 };
+
+	const int WARMUP = 10;
+	const int FRAMES = 60;
+	int max_threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	printf("bodies threads ms/frame speedup hash\n");
+	for (int bodies : sizes)
+	{
+		double single = 0.0;
+		for (int threads = 1; threads <= max_threads; threads++)
+		{
+			// a fresh system each run, the solver state left by the last run is dropped too
+			build_board(bodies);
+			PhysicsSystem physics;
+			physics.reset();
+			physics.set_solver_threads(threads);
+			for (int frame = 0; frame < WARMUP; frame++)
+				physics.step(16.f);
+
+			double ms = bench_ms(FRAMES, [&] {
+				physics.step(16.f);
+				bench_drop_contacts();
+			});
+			if (threads == 1)
+				single = ms;
+
+			double hash = 0.0;
+			for (const physObj& obj : registry.physObjs.components)
+				for (int i = 0; i < obj.VertexCount; i++)
+					hash = hash * 1.0000001 + obj.Vertices[i].pos.x * 3.1 + obj.Vertices[i].pos.y;
+			printf("%6d %7d %8.3f %7.2f %.17g\n", bodies, threads, ms, single / ms, hash);
+		}
+	}
+	return 0;
+}
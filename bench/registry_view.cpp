@@ -0,0 +1,68 @@
+// Registry joins, hand written loops against view<...>() and query<...>()
+// Usage: registry_view_bench
+// Every entity has a Motion, half of them a RenderRequest and a tenth of those are in Combat, as in the
+// render pass. Times one pass over Motion + RenderRequest without Combat written four ways.
+
+// internal
+#include "bench.hpp"
+
+// stlib
+#include <cstdio>
+
+static void build(int count)
+{
+	registry.clear_all_components();
+	for (int i = 0; i < count; i++)
+	{
+		Entity entity = Entity::create();
+		registry.motions.emplace(entity).position = { (float)i, 0.f };
+		if (i % 2 == 0)
+		{
+			registry.renderRequests.emplace(entity);
+			if (i % 20 == 0)
+				registry.combat.emplace(entity);
+		}
+	}
+}
+
+int main()
+{
+	const int SIZES[] = { 1000, 10000, 100000 };
+
+	printf("entities loop_us view_each_us view_iter_us query_us sum\n");
+	for (int count : SIZES)
+	{
+		build(count);
+		int passes = 2000000 / count;
+		double sums[4] = {};
+
+		// how the systems were written before, driven by the smaller container
+		double loop = bench_ms(passes, [&] {
+			for (Entity entity : registry.renderRequests.entities)
+			{
+				if (!registry.motions.has(entity) || registry.combat.has(entity))
+					continue;
+				sums[0] += registry.motions.get(entity).position.x;
+			}
+		});
+		double each = bench_ms(passes, [&] {
+			registry.view<Motion, RenderRequest>(exclude<Combat>).each([&](Entity, Motion& motion, RenderRequest&) {
+				sums[1] += motion.position.x;
+			});
+		});
+		double iter = bench_ms(passes, [&] {
+			auto view = registry.view<Motion, RenderRequest>(exclude<Combat>);
+			for (Entity entity : view)
+				sums[2] += view.get<Motion>(entity).position.x;
+		});
+		double query = bench_ms(passes, [&] {
+			for (Entity entity : registry.query<RenderRequest, Motion>(exclude<Combat>))
+				sums[3] += registry.motions.get(entity).position.x;
+		});
+
+		// all four visit the same entities
+		bool same = sums[0] == sums[1] && sums[0] == sums[2] && sums[0] == sums[3];
+		printf("%8d %7.2f %12.2f %12.2f %8.2f %.0f%s\n", count, loop * 1000.0, each * 1000.0, iter * 1000.0, query * 1000.0, sums[0] / passes, same ? "" : " MISMATCH");
+	}
+	return 0;
+}
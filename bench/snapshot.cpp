@@ -0,0 +1,78 @@
+// Registry snapshot and restore of a combat scene
+// Usage: snapshot_bench [boxes], defaults to 100
+// Builds a pinball board with walls, 10 enemies and a pile of boxes next to 200 world mode entities,
+// then times registry.snapshot() and registry.restore(). Replays a second of frames from the same
+// snapshot twice to check that a restore gives back exactly the same simulation.
+
+// internal
+#include "bench.hpp"
+#include "physics_system.hpp"
+
+// stlib
+#include <cstdio>
+#include <cstdlib>
+
+static void build_scene(int boxes)
+{
+	registry.clear_all_components();
+	for (int i = 0; i < 200; i++)
+	{
+		Entity entity = Entity::create();
+		registry.motions.emplace(entity).position = { (float)(i % 20) * 50.f, (float)(i / 20) * 50.f };
+		registry.renderRequests.emplace(entity);
+	}
+
+	bench_clear_board();
+	bench_box({ 230.f, 400.f }, 20.f, 748.f, false);
+	bench_box({ 830.f, 400.f }, 20.f, 748.f, false);
+	for (int i = 0; i < 10; i++)
+		registry.pinballEnemies.emplace(bench_box({ 300.f + i * 50.f, 300.f }, 40.f, 20.f, false));
+	srand(1);
+	for (int i = 0; i < boxes; i++)
+		bench_box({ 250.f + rand() % 560, 50.f + rand() % 600 }, 20.f, 20.f, true);
+}
+
+// Sum of the body positions after a second of frames
+static double replay(PhysicsSystem& physics)
+{
+	physics.reset();
+	for (int frame = 0; frame < 60; frame++)
+	{
+		physics.step(16.f);
+		bench_drop_contacts();
+	}
+	double hash = 0.0;
+	for (size_t i = 0; i < registry.physObjs.size(); i++)
+	{
+		vec2 position = registry.motions.get(registry.physObjs.entities[i]).position;
+		hash += (i + 1) * (double)(position.x + 7.f * position.y);
+	}
+	return hash;
+}
+
+int main(int argc, char** argv)
+{
+	int boxes = argc > 1 ? atoi(argv[1]) : 100;
+	const int COUNT = 1000;
+
+	build_scene(boxes);
+	PhysicsSystem physics;
+	physics.set_solver_threads(1);
+	replay(physics);
+
+	std::vector<char> snap;
+	double save = bench_ms(COUNT, [&] { snap = registry.snapshot(); });
+	double load = bench_ms(COUNT, [&] { registry.restore(snap); });
+	// every restore leaves the old vertex slices behind, the physics step packs them eventually
+	double pack = bench_ms(COUNT, [&] { phys_pool.compact(registry.physObjs.components); });
+
+	registry.restore(snap);
+	double first = replay(physics);
+	registry.restore(snap);
+	double second = replay(physics);
+
+	printf("entities bodies bytes snapshot_ms restore_ms compact_ms replay\n");
+	printf("%8d %6d %5d %11.4f %10.4f %10.4f %s\n", (int)registry.motions.size(), (int)registry.physObjs.size(), (int)snap.size(),
+		save, load, pack, first == second ? "same" : "DIFFERS");
+	return 0;
+}
@@ -0,0 +1,106 @@
+// Component lookups, sparse set against the old hash map
+// Usage: sparse_set_bench
+// Times insert, has, get and remove of Motion components for 1k, 100k and 1M entities, once with
+// ComponentContainer and once with the std::unordered_map<entity, index> it replaced.
+
+// internal
+#include "bench.hpp"
+
+// stlib
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The component storage before the sparse set, an entity -> array index hash map
+template <typename Component>
+class HashContainer
+{
+	std::unordered_map<unsigned int, unsigned int> map_entity_componentID;
+public:
+	std::vector<Component> components;
+	std::vector<Entity> entities;
+
+	Component& insert(Entity e, Component c)
+	{
+		map_entity_componentID[e] = (unsigned int)components.size();
+		components.push_back(std::move(c));
+		entities.push_back(e);
+		return components.back();
+	}
+	Component& get(Entity e) { return components[map_entity_componentID[e]]; }
+	bool has(Entity e) { return map_entity_componentID.count(e) > 0; }
+	void remove(Entity e)
+	{
+		if (has(e))
+		{
+			unsigned int cID = map_entity_componentID[e];
+			components[cID] = std::move(components.back());
+			entities[cID] = entities.back();
+			map_entity_componentID[entities.back()] = cID;
+			map_entity_componentID.erase(e);
+			components.pop_back();
+			entities.pop_back();
+		}
+	}
+};
+
+// ns per operation of each kind, the sum of the positions read back keeps get from being dropped
+template <typename Container>
+static void run(const char* name, const std::vector<Entity>& order, int rounds)
+{
+	double insert_ns = 0.0, has_ns = 0.0, get_ns = 0.0, remove_ns = 0.0;
+	double sum = 0.0;
+	size_t n = order.size();
+	for (int round = 0; round < rounds; round++)
+	{
+		Container container;
+		insert_ns += bench_ms(1, [&] {
+			for (Entity e : order)
+				container.insert(e, Motion()).position = { (float)e.index(), 0.f };
+		});
+		int found = 0;
+		has_ns += bench_ms(1, [&] {
+			for (Entity e : order)
+				found += container.has(e);
+		});
+		get_ns += bench_ms(1, [&] {
+			for (Entity e : order)
+				sum += container.get(e).position.x;
+		});
+		remove_ns += bench_ms(1, [&] {
+			for (Entity e : order)
+				container.remove(e);
+		});
+		if (found != (int)n)
+			printf("%s lost entities: %d of %d\n", name, found, (int)n);
+	}
+	double scale = 1e6 / ((double)rounds * n);
+	printf("%8d %-7s %8.1f %8.1f %8.1f %8.1f %14.0f\n", (int)n, name, insert_ns * scale, has_ns * scale, get_ns * scale, remove_ns * scale, sum / rounds);
+}
+
+int main()
+{
+	// below the 2^20 entity index limit
+	const int SIZES[] = { 1000, 100000, 1000000 };
+
+	std::vector<Entity> all;
+	for (int i = 0; i < SIZES[2]; i++)
+		all.push_back(Entity::create());
+
+	printf("entities storage insert_ns has_ns get_ns remove_ns sum\n");
+	for (int n : SIZES)
+	{
+		// a fixed shuffle so neither storage sees the entities in creation order
+		std::vector<Entity> order(all.begin(), all.begin() + n);
+		srand(1);
+		for (int i = n - 1; i > 0; i--)
+			std::swap(order[i], order[rand() % (i + 1)]);
+
+		int rounds = n < 100000 ? 200 : n < 1000000 ? 5 : 2;
+		run<HashContainer<Motion>>("hash", order, rounds);
+		run<ComponentContainer<Motion>>("sparse", order, rounds);
+	}
+	return 0;
+}
@@ -0,0 +1,96 @@
+// World mode collision check, grid against all pairs
+// Usage: world_grid_bench
+// Spreads enemies and player bullets over a room that grows with their number, so the density stays
+// the same, and times PhysicsSystem::step_world against the O(n^2) loop over every pair it replaced.
+// Both must find the same collisions every frame.
+
+// internal
+#include "bench.hpp"
+#include "physics_system.hpp"
+#include "tile_map.hpp"
+
+// stlib
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// defined in physics_system.cpp
+bool collides(const Motion& motion1, const Motion& motion2);
+
+static void build_room(int count)
+{
+	registry.clear_all_components();
+	float side = std::sqrt((float)count) * 40.f;
+	room_tiles.reset({ side, side });
+	srand(1);
+	for (int i = 0; i < count; i++)
+	{
+		Entity entity = Entity::create();
+		Motion& motion = registry.motions.emplace(entity);
+		motion.position = { (rand() % 1000) * side / 1000.f, (rand() % 1000) * side / 1000.f };
+		motion.velocity = { (float)(rand() % 200 - 100), (float)(rand() % 200 - 100) };
+		motion.angle = 0.f;
+		motion.scale = { 20.f, 20.f };
+		ColliderLayer& layer = registry.colliderLayers.emplace(entity);
+		if (i % 5 == 0)
+		{
+			layer.layer = LAYER_PLAYER_BULLET;
+			layer.mask = LAYER_ENEMY;
+		}
+		else
+		{
+			layer.layer = LAYER_ENEMY;
+			layer.mask = LAYER_PLAYER | LAYER_PLAYER_BULLET;
+		}
+	}
+}
+
+// The check before the grid, every pair of colliders
+static int all_pairs()
+{
+	auto& motions = registry.motions;
+	int events = 0;
+	for (unsigned int i = 0; i < motions.size(); i++)
+	{
+		Entity entity_i = motions.entities[i];
+		if (!registry.colliderLayers.has(entity_i))
+			continue;
+		for (unsigned int j = i + 1; j < motions.size(); j++)
+		{
+			Entity entity_j = motions.entities[j];
+			if (!registry.colliderLayers.has(entity_j) || !registry.colliderLayers.get(entity_i).accepts(registry.colliderLayers.get(entity_j)))
+				continue;
+			if (collides(motions.components[i], motions.components[j]))
+				events++;
+		}
+	}
+	return events;
+}
+
+int main()
+{
+	const int SIZES[] = { 250, 500, 1000, 2000, 5000 };
+	const int FRAMES = 20;
+
+	printf("bodies grid_ms all_pairs_ms candidates events match\n");
+	for (int count : SIZES)
+	{
+		build_room(count);
+		PhysicsSystem physics;
+		double grid = 0.0, brute = 0.0;
+		long candidates = 0, events = 0;
+		bool match = true;
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			grid += bench_ms(1, [&] { physics.step_world(16.f); });
+			int found = 0;
+			brute += bench_ms(1, [&] { found = all_pairs(); });
+			match = match && found == collision_stats.events;
+			candidates += collision_stats.candidates;
+			events += collision_stats.events;
+			world_contacts.clear();
+		}
+		printf("%6d %7.3f %12.3f %10ld %6ld %5s\n", count, grid / FRAMES, brute / FRAMES, candidates / FRAMES, events / FRAMES, match ? "yes" : "NO");
+	}
+	return 0;
+}
@@ -2,4 +2,4 @@
 
 // Please don't change the content of this header, it is auto generated by CMAKE
 
-#define PROJECT_SOURCE_DIR "C:/Users/imvan/ubc/cs427/team18_project/"
+#define PROJECT_SOURCE_DIR "/root/repo/"
@@ -0,0 +1,85 @@
+// internal
+#include "broadphase.hpp"
+
+// stlib
+#include <algorithm>
+
+void SweepAndPrune::fit(Box& box, const physObj& obj) const
+{
+	vec2 lo = obj.Vertices.pos()[0];
+	vec2 hi = lo;
+	for (int i = 1; i < obj.VertexCount; i++)
+	{
+		lo = min(lo, obj.Vertices.pos()[i]);
+		hi = max(hi, obj.Vertices.pos()[i]);
+	}
+	lo -= obj.radius;
+	hi += obj.radius;
+	box.min_x = lo.x - MARGIN;
+	box.max_x = hi.x + MARGIN;
+	box.min_y = lo.y - MARGIN;
+	box.max_y = hi.y + MARGIN;
+	box.moveable = obj.moveable;
+}
+
+void SweepAndPrune::update(ComponentContainer<physObj>& objs)
+{
+	// Drop boxes of removed bodies and refresh the others, dense indices may have changed since the last call
+	listed.assign(objs.size(), 0);
+	size_t kept = 0;
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		Box box = boxes[i];
+		if (!objs.has(box.entity))
+			continue;
+		box.index = (unsigned int)(&objs.get(box.entity) - objs.components.data());
+		listed[box.index] = 1;
+		fit(box, objs.components[box.index]);
+		boxes[kept++] = box;
+	}
+	boxes.erase(boxes.begin() + kept, boxes.end());
+
+	// New bodies are appended and sorted in below
+	for (unsigned int i = 0; i < objs.size(); i++)
+	{
+		if (listed[i])
+			continue;
+		Box box = { objs.entities[i], i };
+		fit(box, objs.components[i]);
+		boxes.push_back(box);
+	}
+
+	// Insertion sort on the left edge, close to linear as the order barely changes between substeps
+	for (size_t i = 1; i < boxes.size(); i++)
+	{
+		Box box = boxes[i];
+		size_t j = i;
+		while (j > 0 && boxes[j - 1].min_x > box.min_x)
+		{
+			boxes[j] = boxes[j - 1];
+			j--;
+		}
+		boxes[j] = box;
+	}
+
+	// Sweep along x, only boxes that start before the current one ends can overlap it
+	overlapping.clear();
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		const Box& a = boxes[i];
+		for (size_t j = i + 1; j < boxes.size() && boxes[j].min_x <= a.max_x; j++)
+		{
+			const Box& b = boxes[j];
+			if (!a.moveable && !b.moveable)
+				continue;
+			if (a.max_y < b.min_y || b.max_y < a.min_y)
+				continue;
+			overlapping.push_back({ std::min(a.index, b.index), std::max(a.index, b.index) });
+		}
+	}
+
+	// Resolve in the order of the bodies in the registry, like the all pairs loop this replaced
+	std::sort(overlapping.begin(), overlapping.end(), [](const Pair& p, const Pair& q) {
+		return p.a < q.a || (p.a == q.a && p.b < q.b);
+	});
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "common.hpp"
+#include "components.hpp"
+#include "tiny_ecs_registry.hpp"
+
+// Sweep-and-prune broadphase of the pinball physics. Keeps an axis aligned box per physObj sorted by its
+// left edge, the order is kept between substeps so the insertion sort only has to fix the few boxes that
+// moved past each other. Pairs of two static bodies (moveable == false) are never reported.
+class SweepAndPrune
+{
+public:
+	// Unordered pair of indices into registry.physObjs.components, valid until the next structural change
+	struct Pair
+	{
+		unsigned int a;
+		unsigned int b;
+	};
+
+	// Refresh the boxes from the current vertex positions, re-sort and collect the overlapping pairs
+	void update(ComponentContainer<physObj>& objs);
+
+	const std::vector<Pair>& pairs() const { return overlapping; }
+
+	// Forget all boxes, the next update sorts from scratch
+	void clear()
+	{
+		boxes.clear();
+		overlapping.clear();
+	}
+
+private:
+	struct Box
+	{
+		Entity entity;
+		unsigned int index;
+		float min_x, max_x;
+		float min_y, max_y;
+		bool moveable;
+	};
+
+	// Boxes are grown by this much so that pairs pushed into contact during the substep are still tested
+	const float MARGIN = 2.f;
+
+	std::vector<Box> boxes;
+	std::vector<Pair> overlapping;
+	std::vector<char> listed; // scratch, which physObjs already have a box
+
+	void fit(Box& box, const physObj& obj) const;
+};
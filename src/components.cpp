@@ -7,10 +7,15 @@
 // stlib
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 
 
 Debug debugging;
+CollisionStats collision_stats;
+PinballPhysicsStats pinball_physics_stats;
+PhysPool phys_pool;
 float death_timer_timer_ms = 3000;
+SnapshotAssets snapshot_assets;
 
 // Very, VERY simple OBJ loader from https://github.com/opengl-tutorials/ogl tutorial 7
 // (modified to also read vertex color and omit uv and normals)
@@ -162,4 +167,131 @@ bool Mesh::fromVertices(const std::vector<vec2>& inputVertices,
 	}
 
 	return true;
-}
\ No newline at end of file
+}
+unsigned int SnapshotAssets::id_of(const void* asset) const
+{
+	if (asset == nullptr)
+		return (unsigned int)-1;
+	for (unsigned int i = 0; i < assets.size(); i++)
+		if (assets[i] == asset)
+			return i;
+	assert(false && "Asset was not registered for snapshots");
+	return (unsigned int)-1;
+}
+
+void* SnapshotAssets::get(unsigned int id) const
+{
+	if (id == (unsigned int)-1)
+		return nullptr;
+	assert(id < assets.size());
+	return const_cast<void*>(assets[id]);
+}
+
+void serialize_component(std::vector<char>& out, const PositionKeyFrame& frames)
+{
+	unsigned int count = (unsigned int)frames.keyFrames.size();
+	snapshot_write(out, &frames.timeIncrement, sizeof(float));
+	snapshot_write(out, &frames.timeAccumulator, sizeof(float));
+	snapshot_write(out, &count, sizeof(count));
+	snapshot_write(out, frames.keyFrames.data(), count * sizeof(vec3));
+}
+
+void deserialize_component(SnapshotReader& in, PositionKeyFrame& frames)
+{
+	unsigned int count;
+	in.read(&frames.timeIncrement, sizeof(float));
+	in.read(&frames.timeAccumulator, sizeof(float));
+	in.read(&count, sizeof(count));
+	frames.keyFrames.resize(count);
+	in.read(frames.keyFrames.data(), count * sizeof(vec3));
+}
+
+void serialize_component(std::vector<char>& out, const EnterCombatTimer& timer)
+{
+	unsigned int count = (unsigned int)timer.engagedEnemeis.size();
+	snapshot_write(out, &timer.timer_ms, sizeof(float));
+	snapshot_write(out, &count, sizeof(count));
+	snapshot_write(out, timer.engagedEnemeis.data(), count * sizeof(Entity));
+}
+
+void deserialize_component(SnapshotReader& in, EnterCombatTimer& timer)
+{
+	unsigned int count;
+	in.read(&timer.timer_ms, sizeof(float));
+	in.read(&count, sizeof(count));
+	const Entity* enemies = reinterpret_cast<const Entity*>(in.cursor);
+	timer.engagedEnemeis.assign(enemies, enemies + count);
+	in.cursor += count * sizeof(Entity);
+}
+
+void serialize_component(std::vector<char>& out, Mesh* const& mesh)
+{
+	unsigned int id = snapshot_assets.id_of(mesh);
+	snapshot_write(out, &id, sizeof(id));
+}
+
+void deserialize_component(SnapshotReader& in, Mesh*& mesh)
+{
+	unsigned int id;
+	in.read(&id, sizeof(id));
+	mesh = static_cast<Mesh*>(snapshot_assets.get(id));
+}
+
+void serialize_component(std::vector<char>& out, const soundForPhys& sounds)
+{
+	unsigned int ids[3] = {
+		snapshot_assets.id_of(sounds.enemy_death_sound),
+		snapshot_assets.id_of(sounds.enemy_hit_sound),
+		snapshot_assets.id_of(sounds.player_hit_sound) };
+	snapshot_write(out, ids, sizeof(ids));
+}
+
+void deserialize_component(SnapshotReader& in, soundForPhys& sounds)
+{
+	unsigned int ids[3];
+	in.read(ids, sizeof(ids));
+	sounds.enemy_death_sound = static_cast<Mix_Chunk*>(snapshot_assets.get(ids[0]));
+	sounds.enemy_hit_sound = static_cast<Mix_Chunk*>(snapshot_assets.get(ids[1]));
+	sounds.player_hit_sound = static_cast<Mix_Chunk*>(snapshot_assets.get(ids[2]));
+}
+
+void serialize_component(std::vector<char>& out, const physObj& obj)
+{
+	snapshot_write(out, &obj, sizeof(physObj));
+	snapshot_write(out, obj.Vertices.pos(), obj.VertexCount * sizeof(vec2));
+	snapshot_write(out, obj.Vertices.oldPos(), obj.VertexCount * sizeof(vec2));
+	snapshot_write(out, obj.Vertices.accel(), obj.VertexCount * sizeof(vec2));
+	snapshot_write(out, obj.Edges.data(), obj.EdgesCount * sizeof(Edge));
+}
+
+// The restored body gets a new slice, the one it replaces is dropped by the next compaction
+void deserialize_component(SnapshotReader& in, physObj& obj)
+{
+	in.read(&obj, sizeof(physObj));
+	obj.Vertices.offset = phys_pool.allocVertices(obj.VertexCount);
+	obj.Edges.offset = phys_pool.allocEdges(obj.EdgesCount);
+	in.read(obj.Vertices.pos(), obj.VertexCount * sizeof(vec2));
+	in.read(obj.Vertices.oldPos(), obj.VertexCount * sizeof(vec2));
+	in.read(obj.Vertices.accel(), obj.VertexCount * sizeof(vec2));
+	in.read(obj.Edges.data(), obj.EdgesCount * sizeof(Edge));
+}
+
+void PhysPool::compact(std::vector<physObj>& bodies)
+{
+	PhysPool packed;
+	for (physObj& obj : bodies)
+	{
+		int from = obj.Vertices.offset;
+		int to = packed.allocVertices(obj.VertexCount);
+		std::copy(pos.begin() + from, pos.begin() + from + obj.VertexCount, packed.pos.begin() + to);
+		std::copy(oldPos.begin() + from, oldPos.begin() + from + obj.VertexCount, packed.oldPos.begin() + to);
+		std::copy(accel.begin() + from, accel.begin() + from + obj.VertexCount, packed.accel.begin() + to);
+		obj.Vertices.offset = to;
+
+		from = obj.Edges.offset;
+		to = packed.allocEdges(obj.EdgesCount);
+		std::copy(edges.begin() + from, edges.begin() + from + obj.EdgesCount, packed.edges.begin() + to);
+		obj.Edges.offset = to;
+	}
+	std::swap(*this, packed);
+}
@@ -155,13 +155,57 @@ struct Motion {
 	vec2 scale = { 10.f, 10.f };
 };
 
-// Stucture to store collision information
-struct Collision
+// Collision layers of world mode entities, see ColliderLayer. Walls, spikes and doors are baked into
+// room_tiles instead.
+enum COLLIDER_LAYER : unsigned int {
+	LAYER_PLAYER = 1u << 0,
+	LAYER_ENEMY = 1u << 1,
+	LAYER_PLAYER_BULLET = 1u << 2,
+	LAYER_ENEMY_BULLET = 1u << 3,
+	LAYER_DROP = 1u << 4,
+};
+const unsigned int COLLIDER_LAYER_COUNT = 5;
+
+// Position of a single layer bit, e.g. to index tables by layer
+inline unsigned int colliderLayerIndex(unsigned int layer)
 {
-	// Note, the first object is stored in the ECS container.entities
-	Entity other_entity; // the second object involved in the collision
-	Collision(Entity& other_entity) { this->other_entity = other_entity; };
+	unsigned int index = 0;
+	while (layer > 1)
+	{
+		layer >>= 1;
+		index++;
+	}
+	return index;
+}
+
+// The layer of a world mode entity and the layers it can collide with. A pair is only tested if both
+// sides accept each other, entities without a ColliderLayer never collide.
+struct ColliderLayer
+{
+	unsigned int layer = 0;
+	unsigned int mask = 0;
+
+	bool accepts(const ColliderLayer& other) const { return (mask & other.layer) && (other.mask & layer); }
+};
+
+// Pair counts of the last world mode collision check, shown in debug mode
+struct CollisionStats
+{
+	int candidates = 0; // pairs of colliders sharing a grid cell
+	int rejected_by_layer = 0; // candidates whose layers never interact
+	int events = 0; // pairs that collided and were pushed to world_contacts
+};
+extern CollisionStats collision_stats;
+
+// Pinball solver counts of the last PhysicsSystem::step, shown in debug mode
+struct PinballPhysicsStats
+{
+	int active = 0; // dynamic and kinematic bodies
+	int sleeping = 0;
+	int static_bodies = 0;
+	int substeps = 0;
 };
+extern PinballPhysicsStats pinball_physics_stats;
 
 // Data structure for toggling debug mode
 struct Debug {
@@ -224,11 +268,12 @@ struct Mesh
 
 
 
+// Reference to one vertex of a physObj, the fields themselves are stored in phys_pool
 struct Vertex_Phys {
-	vec2 pos;
-	vec2 oldPos;
+	vec2& pos;
+	vec2& oldPos;
 
-	vec2 accel;
+	vec2& accel;
 
 };
 
@@ -245,14 +290,79 @@ struct Edge {
 
 };
 
+// Vertices and edges of all the pinball bodies, each physObj owns a slice (offset + count) of it.
+// The vertex fields are struct of arrays so the Verlet integration runs over contiguous floats.
+// Removed bodies leave holes until compact() packs the live slices again in body order.
+struct PhysPool {
+	std::vector<vec2> pos;
+	std::vector<vec2> oldPos;
+	std::vector<vec2> accel;
+	std::vector<Edge> edges;
+
+	int allocVertices(int count)
+	{
+		int offset = (int)pos.size();
+		pos.resize(offset + count, vec2(0.f));
+		oldPos.resize(offset + count, vec2(0.f));
+		accel.resize(offset + count, vec2(0.f));
+		return offset;
+	}
+
+	int allocEdges(int count)
+	{
+		int offset = (int)edges.size();
+		edges.resize(offset + count, Edge{});
+		return offset;
+	}
+
+	void compact(std::vector<physObj>& bodies);
+};
+extern PhysPool phys_pool;
+
+// The vertices of a physObj. Vertices[i] gives access to a single vertex, the pointers and the
+// Vertex_Phys references are only valid until the next allocVertices or compact(), both can move
+// the pool. Keep the slice (or the body) around instead and index it again after creating or
+// restoring a body.
+struct VertexSlice {
+	int offset = 0;
+
+	vec2* pos() const { return phys_pool.pos.data() + offset; }
+	vec2* oldPos() const { return phys_pool.oldPos.data() + offset; }
+	vec2* accel() const { return phys_pool.accel.data() + offset; }
+
+	Vertex_Phys operator[](int i) const { return { pos()[i], oldPos()[i], accel()[i] }; }
+};
+
+struct EdgeSlice {
+	int offset = 0;
+
+	Edge* data() const { return phys_pool.edges.data() + offset; }
+	Edge& operator[](int i) const { return data()[i]; }
+};
+
+// How the pinball solver treats a body
+enum class BODY_STATE {
+	STATIC = 0, // never moves, only collided against
+	KINEMATIC = STATIC + 1, // moved by its accel or from outside the solver, never sleeps
+	DYNAMIC = KINEMATIC + 1,
+	SLEEPING = DYNAMIC + 1 // a dynamic body that stopped, woken by an accel or a moving contact
+};
+
 struct physObj {
 
-	Vertex_Phys Vertices[8];
-	Edge Edges[13];
+	VertexSlice Vertices;
+	EdgeSlice Edges;
+
+	// a circle when positive, it is one vertex at the center and no edges
+	float radius = 0.f;
 
 
 	vec2 center;
 
+	// state at the start of the last fixed step, the renderer interpolates from it
+	vec2 prevCenter = {0.f, 0.f};
+	float prevAngle = 0.f;
+
 	int VertexCount;
 	int EdgesCount;
 
@@ -260,6 +370,13 @@ struct physObj {
 
     bool hasGravity = true;
 
+	// swept against the static bodies every substep so it cannot tunnel through them
+	bool ccd = false;
+
+	BODY_STATE state = BODY_STATE::DYNAMIC;
+	// substeps in a row spent below the sleep speed
+	int stillSteps = 0;
+
 	float knockbackCoef;
 };
 
@@ -343,6 +460,34 @@ struct soundForPhys {
 	Mix_Chunk* player_hit_sound;
 };
 
+// Asset pointers held by components (Mesh*, Mix_Chunk*) are written to registry snapshots as their
+// index in this table. Assets are registered once after loading, always in the same order.
+struct SnapshotAssets
+{
+	std::vector<const void*> assets;
+
+	void add(const void* asset) { assets.push_back(asset); }
+	unsigned int id_of(const void* asset) const;
+	void* get(unsigned int id) const;
+};
+extern SnapshotAssets snapshot_assets;
+
+// Components that can not be copied into a snapshot as raw bytes
+template <> struct snapshot_bulk_copy<Mesh*> : std::false_type {};
+template <> struct snapshot_bulk_copy<soundForPhys> : std::false_type {};
+template <> struct snapshot_bulk_copy<physObj> : std::false_type {};
+
+void serialize_component(std::vector<char>& out, const PositionKeyFrame& frames);
+void deserialize_component(SnapshotReader& in, PositionKeyFrame& frames);
+void serialize_component(std::vector<char>& out, const EnterCombatTimer& timer);
+void deserialize_component(SnapshotReader& in, EnterCombatTimer& timer);
+void serialize_component(std::vector<char>& out, Mesh* const& mesh);
+void deserialize_component(SnapshotReader& in, Mesh*& mesh);
+void serialize_component(std::vector<char>& out, const soundForPhys& sounds);
+void deserialize_component(SnapshotReader& in, soundForPhys& sounds);
+void serialize_component(std::vector<char>& out, const physObj& obj);
+void deserialize_component(SnapshotReader& in, physObj& obj);
+
 
 /**
  * The following enumerators represent global identifiers refering to graphic
@@ -0,0 +1,29 @@
+// internal
+#include "contact_stream.hpp"
+
+// stlib
+#include <algorithm>
+
+ContactStream world_contacts(4096);
+ContactStream pinball_contacts(16384);
+ContactStream pinball_floor_contacts(1024);
+
+ContactStream::ContactStream(unsigned int capacity)
+	: slots(new Slot[capacity]), capacity(capacity), count(0), dropped(0)
+{
+}
+
+void ContactStream::reserve(unsigned int extra)
+{
+	unsigned int n = (unsigned int)size();
+	if (n + extra <= capacity)
+		return;
+
+	unsigned int grown = std::max(2 * capacity, n + extra);
+	std::unique_ptr<Slot[]> bigger(new Slot[grown]);
+	for (unsigned int i = 0; i < n; i++)
+		new (&bigger[i]) Contact(begin()[i]);
+	slots = std::move(bigger);
+	capacity = grown;
+	count.store(n, std::memory_order_relaxed); // past the old capacity were only dropped contacts
+}
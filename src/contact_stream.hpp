@@ -0,0 +1,76 @@
+#pragma once
+
+#include "common.hpp"
+#include "tiny_ecs.hpp"
+
+// stlib
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// A contact found by a narrowphase, the normal points from b towards a
+struct Contact
+{
+	Entity a;
+	Entity b;
+	vec2 normal;
+	float depth;
+};
+
+// Flat per-frame list of contacts. Appending is lock-free so narrowphase workers can push concurrently,
+// reading, clear() and reserve() must not overlap with appending. The producer reserves room for what
+// it may push before pushing, a contact past the capacity is a bug: it asserts, and in release builds
+// it is dropped and counted in overflow().
+class ContactStream
+{
+	// raw storage, a contact is only constructed when it is pushed
+	typedef typename std::aligned_storage<sizeof(Contact), alignof(Contact)>::type Slot;
+	std::unique_ptr<Slot[]> slots;
+	unsigned int capacity;
+	std::atomic<unsigned int> count;
+	std::atomic<unsigned int> dropped;
+
+public:
+	explicit ContactStream(unsigned int capacity);
+
+	void push(Entity a, Entity b, vec2 normal, float depth)
+	{
+		unsigned int index = count.fetch_add(1, std::memory_order_relaxed);
+		assert(index < capacity && "ContactStream full, reserve() before pushing");
+		if (index >= capacity)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		new (&slots[index]) Contact{ a, b, normal, depth };
+	}
+
+	// Grows the capacity to hold extra more contacts than it has now
+	void reserve(unsigned int extra);
+
+	void clear()
+	{
+		count.store(0, std::memory_order_relaxed);
+	}
+
+	size_t size() const
+	{
+		unsigned int n = count.load(std::memory_order_relaxed);
+		return n < capacity ? n : capacity;
+	}
+
+	const Contact* begin() const { return reinterpret_cast<const Contact*>(slots.get()); }
+	const Contact* end() const { return begin() + size(); }
+
+	// Contacts lost because the stream was full, since the start
+	unsigned int overflow() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+// Contacts of the world mode collision check, consumed by WorldSystem::handle_collisions_world
+extern ContactStream world_contacts;
+// Contacts of the pinball solver, consumed by PinballCombatSystem
+extern ContactStream pinball_contacts;
+// Bodies that deal damage reaching the bottom of the pinball board, a and b are both the body
+extern ContactStream pinball_floor_contacts;
@@ -11,6 +11,7 @@
 #include "world_system.hpp"
 #include "ai_system.hpp"
 #include "pinball_system.hpp"
+#include "pinball_combat_system.hpp"
 
 using Clock = std::chrono::high_resolution_clock;
 
@@ -27,6 +28,7 @@ int main()
 	RenderSystem render_system;
 	PhysicsSystem physics_system;
 	PinballSystem pinballSystem;
+	PinballCombatSystem pinball_combat_system;
 	AISystem ai_system;
 
 	// Initializing window
@@ -58,6 +60,8 @@ int main()
 			(float)(std::chrono::duration_cast<std::chrono::microseconds>(now - t)).count() / 1000;
 		t = now;
 
+		bool combat_frame = false;
+		bool left_combat = false;
 		if (GameSceneState == 0 && !tutorial_open)
 		{
 			if (Enter_combat_timer <= 0.f)
@@ -84,20 +88,31 @@ int main()
 			}
 
 			pinballSystem.step(elapsed_ms);
-			if (GameSceneState == 0)
+			left_combat = GameSceneState == 0;
+			combat_frame = !left_combat;
+			if (combat_frame)
 			{
-				continue;
+				physics_system.step(elapsed_ms);
+				pinball_combat_system.step();
+				ai_system.step(elapsed_ms);
 			}
-			physics_system.step(elapsed_ms);
-			ai_system.step(elapsed_ms);
-//			pinballSystem.handle_collisions();
-			render_system.draw_combat_scene();
 		}
 		else if (GameSceneState == -1 || GameSceneState == -2)
 		{
 			world_system.step_world(elapsed_ms);
 		}
 
+		// the one sync point of the frame, apply the structural changes recorded by the systems before drawing
+		command_buffer.flush();
+
+		// nothing is drawn in the frame the combat ends
+		if (left_combat)
+			continue;
+
+		if (combat_frame)
+		{
+			render_system.draw_combat_scene();
+		}
 		if (GameSceneState == 0 || GameSceneState == -1 || GameSceneState == -2)
 		{
 			render_system.draw_world(tutorial_open);
@@ -0,0 +1,203 @@
+// internal
+#include "physics_kernels.hpp"
+
+// stlib
+#include <cmath>
+#include <random>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define PHYSICS_KERNELS_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PHYSICS_KERNELS_SSE
+#endif
+
+void integrate_verlet(vec2* pos, vec2* oldPos, vec2* accel, int count, float velocity_scale, float accel_scale)
+{
+	// vec2 is two tightly packed floats, the update is the same for x and y
+	float* p = &pos[0].x;
+	float* o = &oldPos[0].x;
+	float* a = &accel[0].x;
+	const int n = count * 2;
+	int i = 0;
+
+#ifdef PHYSICS_KERNELS_AVX
+	const __m256 vs_8 = _mm256_set1_ps(velocity_scale);
+	const __m256 as_8 = _mm256_set1_ps(accel_scale);
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 curr = _mm256_loadu_ps(p + i);
+		__m256 velocity = _mm256_mul_ps(_mm256_sub_ps(curr, _mm256_loadu_ps(o + i)), vs_8);
+		__m256 next = _mm256_add_ps(_mm256_add_ps(curr, velocity), _mm256_mul_ps(_mm256_loadu_ps(a + i), as_8));
+		_mm256_storeu_ps(o + i, curr);
+		_mm256_storeu_ps(p + i, next);
+		_mm256_storeu_ps(a + i, _mm256_setzero_ps());
+	}
+#endif
+#ifdef PHYSICS_KERNELS_SSE
+	const __m128 vs_4 = _mm_set1_ps(velocity_scale);
+	const __m128 as_4 = _mm_set1_ps(accel_scale);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 curr = _mm_loadu_ps(p + i);
+		__m128 velocity = _mm_mul_ps(_mm_sub_ps(curr, _mm_loadu_ps(o + i)), vs_4);
+		__m128 next = _mm_add_ps(_mm_add_ps(curr, velocity), _mm_mul_ps(_mm_loadu_ps(a + i), as_4));
+		_mm_storeu_ps(o + i, curr);
+		_mm_storeu_ps(p + i, next);
+		_mm_storeu_ps(a + i, _mm_setzero_ps());
+	}
+#endif
+	for (; i < n; i++)
+	{
+		float curr = p[i];
+		p[i] = curr + (curr - o[i]) * velocity_scale + a[i] * accel_scale;
+		o[i] = curr;
+		a[i] = 0.f;
+	}
+}
+
+void project_gaps_scalar(const vec2* a, int a_count, const vec2* b, int b_count,
+	const float* axis_x, const float* axis_y, int axis_count, float* gap)
+{
+	for (int i = 0; i < axis_count; i++)
+	{
+		float min_a = axis_x[i] * a[0].x + axis_y[i] * a[0].y;
+		float max_a = min_a;
+		for (int k = 1; k < a_count; k++)
+		{
+			float dp = axis_x[i] * a[k].x + axis_y[i] * a[k].y;
+			min_a = min(min_a, dp);
+			max_a = max(max_a, dp);
+		}
+
+		float min_b = axis_x[i] * b[0].x + axis_y[i] * b[0].y;
+		float max_b = min_b;
+		for (int k = 1; k < b_count; k++)
+		{
+			float dp = axis_x[i] * b[k].x + axis_y[i] * b[k].y;
+			min_b = min(min_b, dp);
+			max_b = max(max_b, dp);
+		}
+
+		gap[i] = min_a < min_b ? min_b - max_a : min_a - max_b;
+	}
+}
+
+void project_gaps(const vec2* a, int a_count, const vec2* b, int b_count,
+	const float* axis_x, const float* axis_y, int axis_count, float* gap)
+{
+	int i = 0;
+
+	// Every vertex is broadcast and projected on all the axes of a batch, a lane per axis
+#ifdef PHYSICS_KERNELS_AVX
+	for (; i + 8 <= axis_count; i += 8)
+	{
+		__m256 ax = _mm256_loadu_ps(axis_x + i), ay = _mm256_loadu_ps(axis_y + i);
+		__m256 min_a = _mm256_add_ps(_mm256_mul_ps(ax, _mm256_set1_ps(a[0].x)), _mm256_mul_ps(ay, _mm256_set1_ps(a[0].y)));
+		__m256 max_a = min_a;
+		for (int k = 1; k < a_count; k++)
+		{
+			__m256 dp = _mm256_add_ps(_mm256_mul_ps(ax, _mm256_set1_ps(a[k].x)), _mm256_mul_ps(ay, _mm256_set1_ps(a[k].y)));
+			min_a = _mm256_min_ps(min_a, dp);
+			max_a = _mm256_max_ps(max_a, dp);
+		}
+		__m256 min_b = _mm256_add_ps(_mm256_mul_ps(ax, _mm256_set1_ps(b[0].x)), _mm256_mul_ps(ay, _mm256_set1_ps(b[0].y)));
+		__m256 max_b = min_b;
+		for (int k = 1; k < b_count; k++)
+		{
+			__m256 dp = _mm256_add_ps(_mm256_mul_ps(ax, _mm256_set1_ps(b[k].x)), _mm256_mul_ps(ay, _mm256_set1_ps(b[k].y)));
+			min_b = _mm256_min_ps(min_b, dp);
+			max_b = _mm256_max_ps(max_b, dp);
+		}
+		__m256 a_first = _mm256_cmp_ps(min_a, min_b, _CMP_LT_OQ);
+		_mm256_storeu_ps(gap + i, _mm256_blendv_ps(_mm256_sub_ps(min_a, max_b), _mm256_sub_ps(min_b, max_a), a_first));
+	}
+#endif
+#ifdef PHYSICS_KERNELS_SSE
+	for (; i + 4 <= axis_count; i += 4)
+	{
+		__m128 ax = _mm_loadu_ps(axis_x + i), ay = _mm_loadu_ps(axis_y + i);
+		__m128 min_a = _mm_add_ps(_mm_mul_ps(ax, _mm_set1_ps(a[0].x)), _mm_mul_ps(ay, _mm_set1_ps(a[0].y)));
+		__m128 max_a = min_a;
+		for (int k = 1; k < a_count; k++)
+		{
+			__m128 dp = _mm_add_ps(_mm_mul_ps(ax, _mm_set1_ps(a[k].x)), _mm_mul_ps(ay, _mm_set1_ps(a[k].y)));
+			min_a = _mm_min_ps(min_a, dp);
+			max_a = _mm_max_ps(max_a, dp);
+		}
+		__m128 min_b = _mm_add_ps(_mm_mul_ps(ax, _mm_set1_ps(b[0].x)), _mm_mul_ps(ay, _mm_set1_ps(b[0].y)));
+		__m128 max_b = min_b;
+		for (int k = 1; k < b_count; k++)
+		{
+			__m128 dp = _mm_add_ps(_mm_mul_ps(ax, _mm_set1_ps(b[k].x)), _mm_mul_ps(ay, _mm_set1_ps(b[k].y)));
+			min_b = _mm_min_ps(min_b, dp);
+			max_b = _mm_max_ps(max_b, dp);
+		}
+		// SSE2 has no blend, select with and/andnot
+		__m128 a_first = _mm_cmplt_ps(min_a, min_b);
+		__m128 result = _mm_or_ps(_mm_and_ps(a_first, _mm_sub_ps(min_b, max_a)), _mm_andnot_ps(a_first, _mm_sub_ps(min_a, max_b)));
+		_mm_storeu_ps(gap + i, result);
+	}
+#endif
+	if (i < axis_count)
+		project_gaps_scalar(a, a_count, b, b_count, axis_x + i, axis_y + i, axis_count - i, gap + i);
+}
+
+int check_project_gaps(int trials, unsigned int seed)
+{
+	const int MAX_VERTICES = 16;
+	const int MAX_AXES = 24; // past the 8 and 4 wide batches into the scalar tail
+	vec2 a[MAX_VERTICES], b[MAX_VERTICES];
+	float axis_x[MAX_AXES], axis_y[MAX_AXES], gap[MAX_AXES], reference[MAX_AXES];
+
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<float> coordinate(-500.f, 500.f);
+	std::uniform_real_distribution<float> angle(0.f, 6.2831853f);
+	std::uniform_int_distribution<int> vertices(1, MAX_VERTICES);
+	std::uniform_int_distribution<int> axes(1, MAX_AXES);
+
+	int mismatches = 0;
+	for (int trial = 0; trial < trials; trial++)
+	{
+		// every fourth set of points is degenerate: one point repeated, or all on a line
+		int degenerate = trial % 4;
+		auto fill = [&](vec2* points, int count)
+		{
+			vec2 origin = { coordinate(gen), coordinate(gen) };
+			vec2 direction = { cos(angle(gen)), sin(angle(gen)) };
+			for (int k = 0; k < count; k++)
+			{
+				if (degenerate == 1)
+					points[k] = origin;
+				else if (degenerate == 2)
+					points[k] = origin + direction * coordinate(gen);
+				else
+					points[k] = { coordinate(gen), coordinate(gen) };
+			}
+		};
+		int a_count = vertices(gen);
+		int b_count = vertices(gen);
+		int axis_count = axes(gen);
+		fill(a, a_count);
+		fill(b, b_count);
+		for (int i = 0; i < axis_count; i++)
+		{
+			// a zero axis now and then, e.g. from an edge of two equal vertices
+			float theta = angle(gen);
+			float length = degenerate == 3 && i % 5 == 0 ? 0.f : 1.f;
+			axis_x[i] = length * cos(theta);
+			axis_y[i] = length * sin(theta);
+		}
+
+		project_gaps(a, a_count, b, b_count, axis_x, axis_y, axis_count, gap);
+		project_gaps_scalar(a, a_count, b, b_count, axis_x, axis_y, axis_count, reference);
+		for (int i = 0; i < axis_count; i++)
+		{
+			if (!(fabs(gap[i] - reference[i]) <= 1e-3f * (1.f + fabs(reference[i]))))
+				mismatches++;
+		}
+	}
+	return mismatches;
+}
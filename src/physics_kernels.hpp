@@ -0,0 +1,24 @@
+#pragma once
+
+#include "common.hpp"
+#include "components.hpp"
+
+// Vectorised inner loops of the physics system. They work on struct-of-arrays data, SSE2/AVX is
+// used when the compiler targets it and a plain loop otherwise.
+
+// Time corrected Verlet step of count vertices:
+// pos += (pos - oldPos) * velocity_scale + accel * accel_scale, oldPos = pos, accel = 0
+// velocity_scale is dt / previous dt, a fixed step passes 1 and dt^2
+void integrate_verlet(vec2* pos, vec2* oldPos, vec2* accel, int count, float velocity_scale, float accel_scale);
+
+// Separating axis gaps of two convex vertex sets a and b on axis_count axes (SoA). gap[i] is the
+// distance between the two projections on axis i, positive when the axis separates them. The
+// vector paths do 8 or 4 axes at once, project_gaps_scalar is the plain reference.
+void project_gaps(const vec2* a, int a_count, const vec2* b, int b_count,
+	const float* axis_x, const float* axis_y, int axis_count, float* gap);
+void project_gaps_scalar(const vec2* a, int a_count, const vec2* b, int b_count,
+	const float* axis_x, const float* axis_y, int axis_count, float* gap);
+
+// Runs project_gaps and project_gaps_scalar on trials random point sets and axes, including repeated
+// points, collinear points and zero axes, and returns how many gaps differ by more than rounding
+int check_project_gaps(int trials, unsigned int seed);
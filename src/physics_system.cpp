@@ -1,8 +1,15 @@
 // internal
 #include "physics_system.hpp"
 #include "world_init.hpp"
+#include "broadphase.hpp"
+#include "contact_stream.hpp"
+#include "spatial_query.hpp"
+#include "tile_map.hpp"
 #include <world_system.hpp>
 
+// stlib
+#include <cfloat>
+
 // Returns the local bounding coordinates scaled by the current size of the entity
 vec2 get_bounding_box(const Motion &motion)
 {
@@ -32,7 +39,6 @@ bool collides(const Motion &motion1, const Motion &motion2)
 	return dist <= radius_sum;*/
 }
 
-float COMBO_DAMAGE_MULTIPLIER = 0.01f;
 
 float MAX_Y_COORD = 810.0f;
 
@@ -50,6 +56,36 @@ vec2 GRAV = {0.f, 0.00035f};
 
 vec2 BOTTOM_BOUNCE = vec2(0.0f, -0.09f);
 
+// The forces and impulses were tuned at this step length, other lengths scale them to match
+const float REF_STEP_MS = 1000.f / 360.f;
+
+// Length of the last substep, the Verlet velocity pos - oldPos was measured over it
+float last_substep_ms = REF_STEP_MS;
+
+// A swept body stops this far inside what it hit so the narrowphase still reports the contact
+const float CCD_SKIN = 0.5f;
+
+// Share of the speed into a contact a circle keeps when it bounces off, fitted with circle_balls_bench
+// so a ball bounces off a static body as high as the square it replaced
+float CIRCLE_RESTITUTION = 0.36f;
+
+// A dynamic body slower than this (px per ms) for SLEEP_STEPS substeps in a row goes to sleep
+const float SLEEP_SPEED = 0.02f;
+const int SLEEP_STEPS = 120;
+
+// Static and sleeping bodies are skipped by the integration and the constraint passes
+bool isMoving(const physObj &obj)
+{
+	return obj.state == BODY_STATE::DYNAMIC || obj.state == BODY_STATE::KINEMATIC;
+}
+
+void wake(physObj &obj)
+{
+	if (obj.state == BODY_STATE::SLEEPING)
+		obj.state = BODY_STATE::DYNAMIC;
+	obj.stillSteps = 0;
+}
+
 // struct Vertex_Phys {
 //	vec2 pos;
 //	vec2 oldPos;
@@ -88,20 +124,12 @@ struct CollisionEvent
 {
 	vec2 Normal;
 	float Depth;
-	Edge *Edge;
-	Vertex_Phys *Vertex;
+	::Edge *Edge;
+	vec2 *VertexPos;
 	
 	physObj *EdgeParent;
 };
 
-void updatePos(float dt, Vertex_Phys &v)
-{
-	vec2 velocity = v.pos - v.oldPos;
-	v.oldPos = v.pos;
-	v.pos = v.pos + velocity + v.accel * dt * dt;
-	v.accel = {};
-}
-
 void updateEdges(physObj &obj)
 {
 
@@ -123,8 +151,15 @@ void updateEdges(physObj &obj)
 	}
 }
 
-void projectObjToAxis(physObj &Obj, vec2 Axis, float &Max, float &Min)
+void projectObjToAxis(const physObj &Obj, vec2 Axis, float &Max, float &Min)
 {
+	if (Obj.radius > 0.f)
+	{
+		float dp = dot(Axis, Obj.Vertices.pos()[0]);
+		Max = dp + Obj.radius;
+		Min = dp - Obj.radius;
+		return;
+	}
 
 	float dp = dot(Axis, Obj.Vertices[0].pos);
 
@@ -162,9 +197,9 @@ void collisionResponse(CollisionEvent &e, bool otherObjMoveable, float otherObjC
 
 	float fac;
 	if (abs(e.EdgeParent->Vertices[E1].pos.x - e.EdgeParent->Vertices[E2].pos.x) > abs(e.EdgeParent->Vertices[E1].pos.y - e.EdgeParent->Vertices[E2].pos.y))
-		fac = (e.Vertex->pos.x - CollisionVector.x - e.EdgeParent->Vertices[E1].pos.x) / (e.EdgeParent->Vertices[E2].pos.x - e.EdgeParent->Vertices[E1].pos.x);
+		fac = ((*e.VertexPos).x - CollisionVector.x - e.EdgeParent->Vertices[E1].pos.x) / (e.EdgeParent->Vertices[E2].pos.x - e.EdgeParent->Vertices[E1].pos.x);
 	else
-		fac = (e.Vertex->pos.y - CollisionVector.y - e.EdgeParent->Vertices[E1].pos.y) / (e.EdgeParent->Vertices[E2].pos.y - e.EdgeParent->Vertices[E1].pos.y);
+		fac = ((*e.VertexPos).y - CollisionVector.y - e.EdgeParent->Vertices[E1].pos.y) / (e.EdgeParent->Vertices[E2].pos.y - e.EdgeParent->Vertices[E1].pos.y);
 
 	float Lambda = 1.0f / (fac * fac + (1 - fac) * (1 - fac));
 
@@ -177,69 +212,249 @@ void collisionResponse(CollisionEvent &e, bool otherObjMoveable, float otherObjC
 
 	if (otherObjMoveable)
 	{
-		e.Vertex->pos += CollisionVector * 0.5f * otherObjCoef;
+		(*e.VertexPos) += CollisionVector * 0.5f * otherObjCoef;
 	}
 }
 
-bool detectAndResloveCollision(physObj *a, physObj *b)
+// Two circles, normal points from b to a
+bool circlesOverlap(const physObj &a, const physObj &b, vec2 &normal, float &depth)
 {
+	vec2 d = a.Vertices.pos()[0] - b.Vertices.pos()[0];
+	float dist = length(d);
+	depth = a.radius + b.radius - dist;
+	if (depth <= 0.f)
+		return false;
 
-	float minDist = 15000.0f;
-	CollisionEvent event{};
+	normal = dist > 0.f ? d / dist : vec2(0.f, -1.f);
+	return true;
+}
 
-	physObj *parent;
+// A circle and a polygon, separated on the polygon edge normals or the axis to its closest vertex.
+// normal points from the polygon to the circle, edge is the polygon edge that was hit or -1 when
+// it was the closest vertex.
+bool circlePolygonOverlap(const physObj &circle, const physObj &poly, vec2 &normal, float &depth, int &edge, int &vertex)
+{
+	vec2 c = circle.Vertices.pos()[0];
+	const vec2 *pos = poly.Vertices.pos();
 
-	for (int i = 0; i < a->EdgesCount + b->EdgesCount; i++)
+	int closest = 0;
+	float closest_dist = FLT_MAX;
+	for (int i = 0; i < poly.VertexCount; i++)
 	{
-		Edge *currEdge;
-		if (i < a->EdgesCount)
+		vec2 d = c - pos[i];
+		if (dot(d, d) < closest_dist)
 		{
-			currEdge = &a->Edges[i];
+			closest_dist = dot(d, d);
+			closest = i;
+		}
+	}
 
-			parent = a;
+	depth = FLT_MAX;
+	edge = vertex = -1;
+	for (int i = 0; i <= poly.EdgesCount; i++)
+	{
+		vec2 Axis;
+		if (i < poly.EdgesCount)
+		{
+			const Edge &e = poly.Edges[i];
+			Axis = normalize(vec2(pos[e.v1].y - pos[e.v2].y, pos[e.v2].x - pos[e.v1].x));
 		}
 		else
 		{
-			currEdge = &b->Edges[i - a->EdgesCount];
+			if (closest_dist == 0.f)
+				continue;
+			Axis = (c - pos[closest]) / sqrt(closest_dist);
+		}
+
+		float Max, Min;
+		projectObjToAxis(poly, Axis, Max, Min);
+		float dp = dot(Axis, c);
+		float overlap = min(Max - (dp - circle.radius), (dp + circle.radius) - Min);
+		if (overlap <= 0.f)
+			return false;
 
-			parent = b;
+		if (overlap < depth)
+		{
+			depth = overlap;
+			normal = Axis;
+			edge = i < poly.EdgesCount ? i : -1;
+			vertex = i < poly.EdgesCount ? -1 : closest;
 		}
+	}
 
-		vec2 Axis = vec2((*parent).Vertices[currEdge->v1].pos.y - (*parent).Vertices[currEdge->v2].pos.y,
-						 (*parent).Vertices[currEdge->v2].pos.x - (*parent).Vertices[currEdge->v1].pos.x);
-		Axis = normalize(Axis);
+	if (dot(normal, c - poly.center) < 0.f)
+		normal = -normal;
+	return true;
+}
 
-		float MinA, MinB, MaxA, MaxB;
+// Same split as collisionResponse: the circle is pushed out like a vertex, the polygon edge
+// or vertex it hit is pushed back. A square ball bounced off through its corners and edge
+// relaxation, a circle has neither so it bounces by rewriting its Verlet old position.
+bool detectAndResolveCircleCollision(physObj *a, physObj *b, vec2 &normal, float &depth)
+{
+	if (a->radius > 0.f && b->radius > 0.f)
+	{
+		if (!circlesOverlap(*a, *b, normal, depth))
+			return false;
 
-		projectObjToAxis(*a, Axis, MaxA, MinA);
-		projectObjToAxis(*b, Axis, MaxB, MinB);
-		float dist;
+		vec2 velocity_a = a->Vertices.pos()[0] - a->Vertices.oldPos()[0];
+		vec2 velocity_b = b->Vertices.pos()[0] - b->Vertices.oldPos()[0];
+		float into = dot(velocity_a - velocity_b, normal);
+		float share = a->moveable && b->moveable ? 0.5f : 1.f;
+		vec2 impulse = into < 0.f ? normal * (-(1.f + CIRCLE_RESTITUTION) * into * share) : vec2(0.f);
 
-		if (MinA < MinB)
+		vec2 CollisionVector = normal * depth;
+		if (a->moveable)
 		{
-			dist = MinB - MaxA;
+			a->Vertices.pos()[0] += CollisionVector * 0.5f * a->knockbackCoef;
+			a->Vertices.oldPos()[0] = a->Vertices.pos()[0] - (velocity_a + impulse);
 		}
-		else
+		if (b->moveable)
 		{
-			dist = MinA - MaxB;
+			b->Vertices.pos()[0] -= CollisionVector * 0.5f * b->knockbackCoef;
+			b->Vertices.oldPos()[0] = b->Vertices.pos()[0] - (velocity_b - impulse);
 		}
+		return true;
+	}
 
-		if (dist > 0.0f)
+	physObj *circle = a->radius > 0.f ? a : b;
+	physObj *poly = a->radius > 0.f ? b : a;
+	int edge, vertex;
+	if (!circlePolygonOverlap(*circle, *poly, normal, depth, edge, vertex))
+		return false;
+
+	// velocity of the polygon where the circle touches it
+	vec2 velocity = circle->Vertices.pos()[0] - circle->Vertices.oldPos()[0];
+	vec2 other_velocity;
+	float fac = 0.f;
+	if (edge >= 0)
+	{
+		int v1 = poly->Edges[edge].v1;
+		int v2 = poly->Edges[edge].v2;
+		vec2 edge_dir = poly->Vertices.pos()[v2] - poly->Vertices.pos()[v1];
+		vec2 contact = circle->Vertices.pos()[0] - normal * circle->radius;
+		fac = clamp(dot(contact - poly->Vertices.pos()[v1], edge_dir) / dot(edge_dir, edge_dir), 0.f, 1.f);
+		other_velocity = mix(poly->Vertices.pos()[v1] - poly->Vertices.oldPos()[v1], poly->Vertices.pos()[v2] - poly->Vertices.oldPos()[v2], fac);
+	}
+	else
+	{
+		other_velocity = poly->Vertices.pos()[vertex] - poly->Vertices.oldPos()[vertex];
+	}
+
+	vec2 CollisionVector = normal * depth;
+	if (poly->moveable)
+	{
+		if (edge >= 0)
 		{
-			return false;
+			float Lambda = 1.0f / (fac * fac + (1 - fac) * (1 - fac));
+
+			poly->Vertices.pos()[poly->Edges[edge].v1] -= CollisionVector * (1 - fac) * 0.5f * Lambda * poly->knockbackCoef;
+			poly->Vertices.pos()[poly->Edges[edge].v2] -= CollisionVector * fac * 0.5f * Lambda * poly->knockbackCoef;
 		}
-		else if (abs(dist) < minDist)
+		else
 		{
-			minDist = abs(dist);
+			poly->Vertices.pos()[vertex] -= CollisionVector * 0.5f * poly->knockbackCoef;
+		}
+	}
 
-			event.Normal = Axis;
-			event.Edge = currEdge;
+	if (circle->moveable)
+	{
+		float into = dot(velocity - other_velocity, normal);
+		if (into < 0.f)
+			velocity -= normal * ((1.f + CIRCLE_RESTITUTION) * into);
+
+		circle->Vertices.pos()[0] += CollisionVector * 0.5f * circle->knockbackCoef;
+		circle->Vertices.oldPos()[0] = circle->Vertices.pos()[0] - velocity;
+	}
+	return true;
+}
+
+// Axes handed to project_gaps at once, a multiple of the 4 lanes of SSE
+enum { SAT_BATCH = 8 };
+
+// SAT of two polygons on the edge normals of a, then of b. Returns false on the first axis that
+// separates them, otherwise the axis with the smallest overlap. axis indexes a's then b's edges in
+// both cases. minDist comes in as the largest overlap that counts.
+bool findPenetrationAxis(physObj *a, physObj *b, float &minDist, vec2 &normal, int &axis)
+{
+	const int total = a->EdgesCount + b->EdgesCount;
+	float axis_x[SAT_BATCH], axis_y[SAT_BATCH], gap[SAT_BATCH];
+
+	axis = -1;
+	for (int first = 0; first < total; first += SAT_BATCH)
+	{
+		int count = min((int)SAT_BATCH, total - first);
+		// a partial batch repeats its last axis up to the next multiple of 4
+		int padded = (count + 3) & ~3;
+		for (int k = 0; k < padded; k++)
+		{
+			int i = first + min(k, count - 1);
+			physObj *parent = i < a->EdgesCount ? a : b;
+			const Edge &edge = i < a->EdgesCount ? a->Edges[i] : b->Edges[i - a->EdgesCount];
+			const vec2 *pos = parent->Vertices.pos();
+
+			vec2 Axis = normalize(vec2(pos[edge.v1].y - pos[edge.v2].y, pos[edge.v2].x - pos[edge.v1].x));
+			axis_x[k] = Axis.x;
+			axis_y[k] = Axis.y;
+		}
 
-			event.EdgeParent = parent;
+		project_gaps(a->Vertices.pos(), a->VertexCount, b->Vertices.pos(), b->VertexCount, axis_x, axis_y, padded, gap);
 
-			// emplace this new event
+		for (int k = 0; k < count; k++)
+		{
+			if (gap[k] > 0.0f)
+			{
+				axis = first + k;
+				return false;
+			}
+			if (abs(gap[k]) < minDist)
+			{
+				minDist = abs(gap[k]);
+				normal = vec2(axis_x[k], axis_y[k]);
+				axis = first + k;
+			}
 		}
 	}
+	return axis >= 0;
+}
+
+// Overlap test on the edge normals of both bodies, without resolving anything
+bool detectCollision(physObj *a, physObj *b)
+{
+	vec2 normal;
+	float depth;
+	int edge, vertex;
+	if (a->radius > 0.f && b->radius > 0.f)
+		return circlesOverlap(*a, *b, normal, depth);
+	if (a->radius > 0.f)
+		return circlePolygonOverlap(*a, *b, normal, depth, edge, vertex);
+	if (b->radius > 0.f)
+		return circlePolygonOverlap(*b, *a, normal, depth, edge, vertex);
+
+	float minDist = 15000.0f;
+	vec2 Axis;
+	int axis;
+	return findPenetrationAxis(a, b, minDist, Axis, axis);
+}
+
+// separating is the SAT axis that kept two polygons apart, -1 if they touched or one is a circle
+bool detectAndResloveCollision(physObj *a, physObj *b, vec2 &normal, float &depth, int &separating)
+{
+	separating = -1;
+	if (a->radius > 0.f || b->radius > 0.f)
+		return detectAndResolveCircleCollision(a, b, normal, depth);
+
+	float minDist = 15000.0f;
+	CollisionEvent event{};
+
+	int axis;
+	if (!findPenetrationAxis(a, b, minDist, event.Normal, axis))
+	{
+		separating = axis;
+		return false;
+	}
+	event.EdgeParent = axis < a->EdgesCount ? a : b;
+	event.Edge = axis < a->EdgesCount ? &a->Edges[axis] : &b->Edges[axis - a->EdgesCount];
 
 	event.Depth = minDist;
 
@@ -269,16 +484,18 @@ bool detectAndResloveCollision(physObj *a, physObj *b)
 		if (distance < smallestDist)
 		{
 			smallestDist = distance;
-			event.Vertex = &a->Vertices[i];
+			event.VertexPos = &a->Vertices.pos()[i];
 		}
 	}
 
 	collisionResponse(event, a->moveable, a->knockbackCoef);
 
+	normal = event.Normal;
+	depth = event.Depth;
 	return true;
 }
 
-void accelerate(vec2 acc, Vertex_Phys &obj)
+void accelerate(vec2 acc, Vertex_Phys obj)
 {
 	obj.accel += acc;
 }
@@ -291,121 +508,366 @@ void accelerateObj(vec2 acc, physObj &obj)
 	}
 }
 
-void updateAllEdges()
+// Scenes smaller than this are solved on the calling thread, in broadphase order for the contacts
+int PARALLEL_MIN_BODIES = 512;
+int PARALLEL_MIN_PAIRS = 512;
+
+void updateAllEdges(WorkerPool &workers)
 {
-	for (uint i = 0; i < registry.physObjs.size(); i++)
+	// every body only touches its own vertices
+	int count = (int)registry.physObjs.size();
+	int grain = count < PARALLEL_MIN_BODIES ? count : 64;
+	workers.parallel_for(count, grain, [](int begin, int end)
 	{
-		physObj &obj = registry.physObjs.components[i];
+		for (int i = begin; i < end; i++)
+		{
+			physObj &obj = registry.physObjs.components[i];
+			if (!isMoving(obj))
+				continue;
+
+			updateEdges(obj);
+		}
+	});
+}
+
+// Broadphase of the pinball bodies, kept between substeps
+SweepAndPrune pinball_broadphase;
+
+// What the narrowphase found for one broadphase pair, in both orientations
+struct PairContacts
+{
+	bool ab, ba;
+	vec2 normal_ab, normal_ba;
+	float depth_ab, depth_ba;
+};
+
+// What the earlier substeps learnt about a pair of bodies. The axis and normal are in the order of
+// the key, the body with the smaller entity id first.
+struct ContactEntry
+{
+	int separating = -1; // SAT axis that kept two polygons apart, it is tried before anything else
+	vec2 normal = vec2(0.f); // from the second body to the first
+	float accumulated = 0.f; // correction along normal the contact needed last substep
+	bool touching = false; // the narrowphase found the bodies in contact the last time it ran
+};
+
+// A contact kept from the last substep and the entity pair it belongs to, in key order
+struct CachedContact
+{
+	uint64_t key;
+	Entity first, second;
+	ContactEntry entry;
+};
+
+// Pinball contacts of the last substep sorted by key. Each substep the broadphase pairs are sorted
+// by key as well and merged against it, a pair the broadphase stopped reporting drops out.
+std::vector<CachedContact> contact_cache;
+
+// Share of last substep's correction pushed in before the narrowphase, a resting contact then only
+// has this substep's gravity left to resolve instead of sinking in until the halved response holds it
+float WARM_START = 0.7f;
 
-		updateEdges(obj);
+uint64_t contactKey(Entity a, Entity b)
+{
+	unsigned int lo = min((unsigned int)a, (unsigned int)b);
+	unsigned int hi = max((unsigned int)a, (unsigned int)b);
+	return (uint64_t(lo) << 32) | hi;
+}
+
+// The axis that separated two polygons last substep usually still does
+bool stillSeparated(const physObj &a, const physObj &b, int axis)
+{
+	if (axis >= a.EdgesCount + b.EdgesCount)
+		return false;
+
+	const physObj &parent = axis < a.EdgesCount ? a : b;
+	const Edge &edge = axis < a.EdgesCount ? a.Edges[axis] : b.Edges[axis - a.EdgesCount];
+	const vec2 *pos = parent.Vertices.pos();
+	vec2 Axis = normalize(vec2(pos[edge.v1].y - pos[edge.v2].y, pos[edge.v2].x - pos[edge.v1].x));
+
+	float MaxA, MinA, MaxB, MinB;
+	projectObjToAxis(a, Axis, MaxA, MinA);
+	projectObjToAxis(b, Axis, MaxB, MinB);
+	return MinB - MaxA > 0.f || MinA - MaxB > 0.f;
+}
+
+// Average Verlet velocity of the vertices of a body
+vec2 bodyVelocity(const physObj &obj)
+{
+	vec2 sum = vec2(0.f);
+	for (int i = 0; i < obj.VertexCount; i++)
+		sum += obj.Vertices.pos()[i] - obj.Vertices.oldPos()[i];
+	return sum / float(obj.VertexCount);
+}
+
+// Moves the bodies of a contact apart along normal without touching their old positions, so in
+// Verlet terms it is an impulse like the ones collisionResponse gives. The split follows the
+// knockback coefficients, a flipper (0) leaves all of it to what it touches.
+void pushApart(physObj &first, physObj &second, vec2 normal, float amount)
+{
+	float weight_first = first.moveable ? first.knockbackCoef : 0.f;
+	float weight_second = second.moveable ? second.knockbackCoef : 0.f;
+	if (weight_first + weight_second <= 0.f)
+		return;
+
+	vec2 push = normal * amount / (weight_first + weight_second);
+	for (int i = 0; i < first.VertexCount && weight_first > 0.f; i++)
+		first.Vertices.pos()[i] += push * weight_first;
+	for (int i = 0; i < second.VertexCount && weight_second > 0.f; i++)
+		second.Vertices.pos()[i] -= push * weight_second;
+}
+
+// Scratch of the parallel narrowphase
+std::vector<std::pair<uint64_t, unsigned int>> pair_keys; // key and index of every broadphase pair, sorted by key
+std::vector<ContactEntry> pair_entries; // cache entry of every broadphase pair, matched serially
+std::vector<PairContacts> pair_contacts;
+std::vector<uint64_t> body_colours; // colours already used by the pairs of each body, one bit each
+std::vector<std::vector<unsigned int>> colour_batches; // pair indices, the last batch holds the leftovers
+
+// A kinematic body that moved during this fixed step, by the AI or by the mouse
+bool kinematicMoved(const physObj &obj)
+{
+	return obj.state == BODY_STATE::KINEMATIC && obj.center != obj.prevCenter;
+}
+
+// The broadphase stopped reporting a pair that was touching, one of the bodies moved away or was
+// removed. Whatever slept on the other one lost its support.
+void wakeDropped(const CachedContact &contact)
+{
+	if (!contact.entry.touching)
+		return;
+	for (Entity entity : { contact.first, contact.second })
+	{
+		if (registry.physObjs.has(entity))
+			wake(registry.physObjs.get(entity));
 	}
 }
 
-void detectAndSolveAllCollisions()
+void solvePair(const SweepAndPrune::Pair &pair, ContactEntry &entry, PairContacts &out)
 {
-	for (uint i = 0; i < registry.physObjs.size(); i++)
+	physObj *a = &registry.physObjs.components[pair.a];
+	physObj *b = &registry.physObjs.components[pair.b];
+	out.ab = out.ba = false;
+
+	// a sleeping body only reacts to something that moves, the narrowphase wakes it up. Only the
+	// moveable side is written, a body that is not moveable can be in several pairs of a batch.
+	if (!isMoving(*a) && !isMoving(*b))
+		return;
+
+	// the cache is in entity order, the pair in dense order
+	bool flipped = registry.physObjs.entities[pair.a] > registry.physObjs.entities[pair.b];
+	physObj *first = flipped ? b : a;
+	physObj *second = flipped ? a : b;
+
+	if (entry.separating >= 0 && stillSeparated(*first, *second, entry.separating))
 	{
-		physObj *a = &registry.physObjs.components[i];
+		entry.touching = false;
+		return;
+	}
+	entry.separating = -1;
 
-		for (uint i2 = 0; i2 < registry.physObjs.size(); i2++)
+	// the other body is awake, a dynamic one wakes it by running into it. A kinematic one only once
+	// it moves, that may also be away from under the sleeping body.
+	if (a->state == BODY_STATE::SLEEPING || b->state == BODY_STATE::SLEEPING)
+	{
+		const physObj &other = a->state == BODY_STATE::SLEEPING ? *b : *a;
+		if (other.state == BODY_STATE::KINEMATIC && !kinematicMoved(other))
+			return;
+		if (!(other.state == BODY_STATE::KINEMATIC && entry.touching) && !detectCollision(a, b))
 		{
-			physObj *b = &registry.physObjs.components[i2];
-			bool collide = false;
+			entry.accumulated = 0.f;
+			entry.touching = false;
+			return;
+		}
+		if (a->moveable)
+			wake(*a);
+		if (b->moveable)
+			wake(*b);
+	}
 
-			if (a != b)
-			{
-				collide = detectAndResloveCollision(a, b);
-			}
+	// warm start, then measure how far the narrowphase moves the bodies apart
+	float warm = entry.accumulated * WARM_START;
+	pushApart(*first, *second, entry.normal, warm);
+	vec2 before = findCenter(*first) - findCenter(*second);
+
+	// Resolve both orientations like the all pairs loop did, the response strength is tuned for it
+	int separating;
+	out.ab = detectAndResloveCollision(a, b, out.normal_ab, out.depth_ab, separating);
+	out.ba = !out.ab && separating >= 0 ? false : detectAndResloveCollision(b, a, out.normal_ba, out.depth_ba, separating);
+
+	// The warm start may only stop the bodies moving into each other. A separating speed above what
+	// the narrowphase push (about its depth) explains came from the warm start and is taken back, so
+	// a bounce is as strong as without it.
+	float pushed = max(out.ab ? out.depth_ab : 0.f, out.ba ? out.depth_ba : 0.f);
+	float separating_speed = dot(bodyVelocity(*first) - bodyVelocity(*second), entry.normal) - pushed;
+	float taken = clamp(separating_speed, 0.f, warm);
+	if (taken > 0.f)
+		pushApart(*first, *second, entry.normal, -taken);
+	warm -= taken;
+
+	entry.touching = out.ab || out.ba;
+	if (!out.ab && !out.ba)
+	{
+		if (separating >= 0 && flipped)
+			separating = separating < b->EdgesCount ? separating + a->EdgesCount : separating - b->EdgesCount;
+		entry.separating = warm > 0.f ? -1 : separating;
+		entry.accumulated = warm;
+		return;
+	}
+
+	vec2 after = findCenter(*first) - findCenter(*second);
+	vec2 normal = out.ab ? out.normal_ab : out.normal_ba;
+	if (dot(normal, after) < 0.f)
+		normal = -normal;
+
+	// a contact that turned keeps only the part of its warm start along the new normal
+	entry.accumulated = max(warm * dot(normal, entry.normal) + dot(after - before, normal), 0.f);
+	entry.normal = normal;
+}
+
+void pushPairContacts(const SweepAndPrune::Pair &pair, const PairContacts &found)
+{
+	Entity entity_a = registry.physObjs.entities[pair.a];
+	Entity entity_b = registry.physObjs.entities[pair.b];
+	if (found.ab)
+		pinball_contacts.push(entity_a, entity_b, found.normal_ab, found.depth_ab);
+	if (found.ba)
+		pinball_contacts.push(entity_b, entity_a, found.normal_ba, found.depth_ba);
+}
+
+// Greedy colouring of the pairs, no two pairs of a colour share a moveable body so a colour can be
+// solved in parallel. This keys on moveable and not on the body state: the narrowphase writes every
+// moveable body, the kinematic flipper included, and only reads the rest (walls, kinematic enemies),
+// so those can be shared within a colour.
+void colourPairs(const std::vector<SweepAndPrune::Pair> &pairs)
+{
+	const int MAX_COLOURS = 64;
+	body_colours.assign(registry.physObjs.size(), 0);
+	for (std::vector<unsigned int> &batch : colour_batches)
+		batch.clear();
+	colour_batches.resize(MAX_COLOURS + 1);
+
+	for (unsigned int i = 0; i < pairs.size(); i++)
+	{
+		unsigned int a = pairs[i].a;
+		unsigned int b = pairs[i].b;
+		bool moveable_a = registry.physObjs.components[a].moveable;
+		bool moveable_b = registry.physObjs.components[b].moveable;
+
+		uint64_t used = (moveable_a ? body_colours[a] : 0) | (moveable_b ? body_colours[b] : 0);
+		int colour = 0;
+		while (colour < MAX_COLOURS && (used >> colour) & 1)
+			colour++;
+
+		colour_batches[colour].push_back(i);
+		if (colour == MAX_COLOURS)
+			continue;
+		if (moveable_a)
+			body_colours[a] |= uint64_t(1) << colour;
+		if (moveable_b)
+			body_colours[b] |= uint64_t(1) << colour;
+	}
+}
+
+void detectAndSolveAllCollisions(WorkerPool &workers, bool cache_contacts)
+{
+	pinball_broadphase.update(registry.physObjs);
+	const std::vector<SweepAndPrune::Pair> &pairs = pinball_broadphase.pairs();
+
+	// the entries are matched before any solving, the workers only touch the entry of their pair
+	pair_keys.resize(pairs.size());
+	for (size_t i = 0; i < pairs.size(); i++)
+		pair_keys[i] = { contactKey(registry.physObjs.entities[pairs[i].a], registry.physObjs.entities[pairs[i].b]), (unsigned int)i };
+	std::sort(pair_keys.begin(), pair_keys.end());
+
+	if (!cache_contacts)
+		contact_cache.clear();
+	pair_entries.assign(pairs.size(), ContactEntry());
+	size_t cached = 0;
+	for (size_t i = 0; i < pair_keys.size(); i++)
+	{
+		for (; cached < contact_cache.size() && contact_cache[cached].key < pair_keys[i].first; cached++)
+			wakeDropped(contact_cache[cached]);
+		if (cached < contact_cache.size() && contact_cache[cached].key == pair_keys[i].first)
+			pair_entries[pair_keys[i].second] = contact_cache[cached++].entry;
+	}
+	for (; cached < contact_cache.size(); cached++)
+		wakeDropped(contact_cache[cached]);
 
-			// Handle Collision
+	// a pair pushes a contact in each orientation at most
+	pinball_contacts.reserve(2 * (unsigned int)pairs.size());
 
-			// If collided with an enemy
-			Entity entity_a = registry.physObjs.entities[i];
-			Entity entity_b = registry.physObjs.entities[i2];
-			if (collide)
+	if ((int)pairs.size() < PARALLEL_MIN_PAIRS)
+	{
+		for (size_t i = 0; i < pairs.size(); i++)
+		{
+			PairContacts found;
+			solvePair(pairs[i], pair_entries[i], found);
+			pushPairContacts(pairs[i], found);
+		}
+	}
+	else
+	{
+		// The colours run one after the other in a fixed order, the result does not depend on the
+		// thread count. The leftovers past the last colour are solved serially.
+		colourPairs(pairs);
+		pair_contacts.resize(pairs.size());
+		for (size_t colour = 0; colour < colour_batches.size(); colour++)
+		{
+			const std::vector<unsigned int> &batch = colour_batches[colour];
+			int grain = colour + 1 == colour_batches.size() ? (int)batch.size() : 32;
+			workers.parallel_for((int)batch.size(), grain, [&](int begin, int end)
 			{
-				if (registry.pinballEnemies.has(entity_a) && !registry.pinballEnemies.has(entity_b) ||
-					registry.pinballEnemies.has(entity_b) && !registry.pinballEnemies.has(entity_a))
-				{
-					Entity enemy = entity_a;
-					// remove enemy upon collision
-					Entity projectile;
-					if (registry.pinballEnemies.has(entity_a))
-					{
-						// registry.remove_all_components_of(entity_a);
-						enemy = entity_a;
-						projectile = entity_b;
-					}
-					else
-					{
-						// registry.remove_all_components_of(entity_b);
-						enemy = entity_b;
-						projectile = entity_a;
-					}
-					PinBallEnemy &pinballEnemy = registry.pinballEnemies.get(enemy);
-					if (pinballEnemy.invincibilityTimer == 0 && registry.attackPower.has(projectile))
-					{
-						float damage =
-							registry.attackPower.get(projectile).damage * (1 + COMBO_DAMAGE_MULTIPLIER * registry.pinballPlayerStatus.components[0].comboCounter);
-
-						pinballEnemy.currentHealth = pinballEnemy.currentHealth - damage < 0 ? 0 : pinballEnemy.currentHealth - damage;
-
-						pinballEnemy.invincibilityTimer += 200.0f;
-
-						Mix_PlayChannel(-1, registry.sfx.components[0].enemy_hit_sound, 0);
-
-						// ticking up combo
-						registry.pinballPlayerStatus.components[0].comboCounter++;
-						printf("Combo = %i ", registry.pinballPlayerStatus.components[0].comboCounter);
-
-						// deducting hits left for temp projectile
-						if (registry.temporaryProjectiles.has(projectile))
-						{
-							if (!registry.temporaryProjectiles.get(projectile).bonusBall)
-							{
-								if (registry.temporaryProjectiles.get(projectile).hitsLeft - 1 <= 0)
-								{
-									registry.remove_all_components_of(projectile);
-								}
-								else
-								{
-									registry.temporaryProjectiles.get(projectile).hitsLeft--;
-								}
-							}
-						}
-					}
-				}
-//                if (registry.swarmEnemies.has(entity_a) && !registry.swarmEnemies.has(entity_b) && !registry.swarmKing.has(entity_b))
-//                {
-//                    registry.remove_all_components_of(entity_a);
-//                }
-			}
+				for (int i = begin; i < end; i++)
+					solvePair(pairs[batch[i]], pair_entries[batch[i]], pair_contacts[batch[i]]);
+			});
 		}
+
+		// in broadphase order so the combat system sees the same contact order every run
+		for (size_t i = 0; i < pairs.size(); i++)
+			pushPairContacts(pairs[i], pair_contacts[i]);
+	}
+
+	// what this substep learnt, already in key order for the next merge
+	contact_cache.resize(cache_contacts ? pair_keys.size() : 0);
+	for (size_t i = 0; i < contact_cache.size(); i++)
+	{
+		const SweepAndPrune::Pair &pair = pairs[pair_keys[i].second];
+		Entity first = registry.physObjs.entities[pair.a];
+		Entity second = registry.physObjs.entities[pair.b];
+		if (first > second)
+			std::swap(first, second);
+		contact_cache[i] = { pair_keys[i].first, first, second, pair_entries[pair_keys[i].second] };
 	}
 }
 
 void updateAllObjPos(float dt)
 {
+	// the velocity is rescaled to the new step length, the accel term keeps one-off impulses
+	// (dash, nudges) as strong as at the tuned step, applyObjGrav scales the constant forces
+	float velocity_scale = dt / last_substep_ms;
+	float accel_scale = dt * REF_STEP_MS;
 
 	for (uint i = 0; i < registry.physObjs.size(); i++)
 	{
 		physObj &obj = registry.physObjs.components[i];
+		if (!isMoving(obj))
+			continue;
 
-		for (int i2 = 0; i2 < obj.VertexCount; i2++)
-		{
-			updatePos(dt, (obj.Vertices[i2]));
-			//			printf("x=%f, y=%f\n", obj.Vertices[i2].pos.x, obj.Vertices[i2].pos.y);
-		}
+		integrate_verlet(obj.Vertices.pos(), obj.Vertices.oldPos(), obj.Vertices.accel(), obj.VertexCount, velocity_scale, accel_scale);
 	}
+	last_substep_ms = dt;
 }
 
-void applyObjGrav()
+void applyObjGrav(float dt)
 {
+	vec2 grav = GRAV * (dt / REF_STEP_MS);
+
 	for (uint i = 0; i < registry.physObjs.size(); i++)
 	{
 		physObj &obj = registry.physObjs.components[i];
 
-		if (obj.moveable)
+		if (obj.moveable && isMoving(obj))
 		{
 
 			for (int i2 = 0; i2 < obj.VertexCount; i2++)
@@ -414,15 +876,15 @@ void applyObjGrav()
 
 				if (status.antiGravityTimer != 0)
 				{
-					accelerate(-GRAV, (obj.Vertices[i2]));
+					accelerate(-grav, (obj.Vertices[i2]));
 				}
 				else if (status.highGravityTimer != 0)
 				{
-					accelerate(3.0f * GRAV, (obj.Vertices[i2]));
+					accelerate(3.0f * grav, (obj.Vertices[i2]));
 				}
 				else
 				{
-					accelerate(GRAV, (obj.Vertices[i2]));
+					accelerate(grav, (obj.Vertices[i2]));
 				}
 			}
 		}
@@ -435,114 +897,367 @@ void updateAllCenters()
 	for (uint i = 0; i < registry.physObjs.size(); i++)
 	{
 		physObj &obj = registry.physObjs.components[i];
+		if (!isMoving(obj))
+			continue;
 
 		obj.center = findCenter(obj);
 	}
 }
 
-void applyGlobalConstraints()
+void applyGlobalConstraints(float dt)
 {
+	vec2 bottom_bounce = BOTTOM_BOUNCE * (dt / REF_STEP_MS);
 
 	for (uint i = 0; i < registry.physObjs.size(); i++)
 	{
 		physObj &obj = registry.physObjs.components[i];
+		if (!isMoving(obj))
+			continue;
 
-		Entity *toRemove = nullptr;
+		// a circle is kept inside by its edge, its only vertex is the center
+		float r = obj.radius;
 
 		for (int i2 = 0; i2 < obj.VertexCount; i2++)
 		{
-			if (obj.Vertices[i2].pos.y > MAX_Y_COORD)
+			if (obj.Vertices[i2].pos.y + r > MAX_Y_COORD)
 			{
 
 				if (registry.damages.has(registry.physObjs.entities[i]))
 				{
-					PinballPlayerStatus &status = registry.pinballPlayerStatus.components[0];
-					accelerateObj(BOTTOM_BOUNCE, obj);
-
-					if (status.invincibilityTimer == 0.0f)
-					{
-						float dmg = registry.damages.get(registry.physObjs.entities[i]).damage;
-						if (status.health < dmg) {
-							status.health = 0.0;
-						} else {
-							status.health -= dmg;
-						}
-						status.invincibilityTimer += 500.0f;
-						printf("PlayerHealth = %f ", status.health);
-
-						Mix_PlayChannel(-1, registry.sfx.components[0].player_hit_sound, 0);
-
-						// reset combo
-						status.comboCounter = 0;
-						printf("Combo = %i ", status.comboCounter);
-
-						// potential bug in this one
-						if (registry.temporaryProjectiles.has(registry.physObjs.entities[i]))
-						{
-							if (registry.temporaryProjectiles.get(registry.physObjs.entities[i]).hitsLeft - 1 <= 0)
-							{
-								toRemove = &registry.physObjs.entities[i];
-								// printf("ready to remove");
-							}
-							else
-							{
-								registry.temporaryProjectiles.get(registry.physObjs.entities[i]).hitsLeft--;
-								printf("hits = %i ", registry.temporaryProjectiles.get(registry.physObjs.entities[i]).hitsLeft);
-							}
-						}
-					}
+					// the square balls had both bottom corners past the floor at once
+					accelerateObj(r > 0.f ? 2.f * bottom_bounce : bottom_bounce, obj);
+
+					// the damage is dealt by PinballCombatSystem
+					Entity projectile = registry.physObjs.entities[i];
+					pinball_floor_contacts.reserve(1);
+					pinball_floor_contacts.push(projectile, projectile, vec2(0.f, -1.f), obj.Vertices[i2].pos.y + r - MAX_Y_COORD);
 				}
 				else
 				{
 
-					obj.Vertices[i2].pos.y = MAX_Y_COORD;
+					obj.Vertices[i2].pos.y = MAX_Y_COORD - r;
 				}
 			}
 
-			if (obj.Vertices[i2].pos.y < MIN_Y_COORD)
+			if (obj.Vertices[i2].pos.y - r < MIN_Y_COORD)
+			{
+				obj.Vertices[i2].pos.y = MIN_Y_COORD + r;
+			}
+
+			if (obj.Vertices[i2].pos.x - r < MIN_X_COORD)
 			{
-				obj.Vertices[i2].pos.y = MIN_Y_COORD;
+				obj.Vertices[i2].pos.x = MIN_X_COORD + r;
 			}
 
-			if (obj.Vertices[i2].pos.x < MIN_X_COORD)
+			if (obj.Vertices[i2].pos.x + r > MAX_X_COORD)
 			{
-				obj.Vertices[i2].pos.x = MIN_X_COORD;
+				obj.Vertices[i2].pos.x = MAX_X_COORD - r;
 			}
+		}
+	}
+}
+
+struct StaticBox
+{
+	vec2 lo, hi;
+};
+
+// Bounds of the bodies that never move, gathered once per substep for the sweeps
+std::vector<StaticBox> static_boxes;
+
+void bodyBounds(const physObj &obj, vec2 *positions, vec2 &lo, vec2 &hi)
+{
+	lo = hi = positions[0];
+	for (int i = 1; i < obj.VertexCount; i++)
+	{
+		lo = min(lo, positions[i]);
+		hi = max(hi, positions[i]);
+	}
+	lo -= obj.radius;
+	hi += obj.radius;
+}
+
+// Time of impact of a box of the given half size moving from start by d against box, 1 if it misses
+float sweepBox(vec2 start, vec2 half, vec2 d, const StaticBox &box, vec2 &normal)
+{
+	vec2 lo = box.lo - half;
+	vec2 hi = box.hi + half;
+
+	// already touching at the start, the narrowphase handles it
+	if (start.x > lo.x && start.x < hi.x && start.y > lo.y && start.y < hi.y)
+		return 1.f;
+
+	float t_enter = 0.f;
+	float t_exit = 1.f;
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (d[axis] == 0.f)
+		{
+			if (start[axis] <= lo[axis] || start[axis] >= hi[axis])
+				return 1.f;
+			continue;
+		}
+
+		float t0 = (lo[axis] - start[axis]) / d[axis];
+		float t1 = (hi[axis] - start[axis]) / d[axis];
+		if (t0 > t1)
+			std::swap(t0, t1);
+
+		if (t0 >= t_enter)
+		{
+			t_enter = t0;
+			normal = vec2(0.f);
+			normal[axis] = d[axis] > 0.f ? -1.f : 1.f;
+		}
+		t_exit = min(t_exit, t1);
+		if (t_enter > t_exit)
+			return 1.f;
+	}
+	return t_enter;
+}
+
+// Swept AABB test of the ccd bodies against the static ones, run right after the integration.
+// A body that would pass through something is moved back to the time of impact and loses the
+// velocity into it, slower bodies are left to the discrete narrowphase.
+void sweepFastBodies()
+{
+	static_boxes.clear();
+	for (uint i = 0; i < registry.physObjs.size(); i++)
+	{
+		physObj &obj = registry.physObjs.components[i];
+		if (obj.moveable)
+			continue;
+
+		StaticBox box;
+		bodyBounds(obj, obj.Vertices.pos(), box.lo, box.hi);
+		static_boxes.push_back(box);
+	}
 
-			if (obj.Vertices[i2].pos.x > MAX_X_COORD)
+	for (uint i = 0; i < registry.physObjs.size(); i++)
+	{
+		physObj &obj = registry.physObjs.components[i];
+		if (!obj.ccd)
+			continue;
+
+		vec2 old_lo, old_hi, lo, hi;
+		bodyBounds(obj, obj.Vertices.oldPos(), old_lo, old_hi);
+		bodyBounds(obj, obj.Vertices.pos(), lo, hi);
+		vec2 half = (old_hi - old_lo) * 0.5f;
+		vec2 start = (old_lo + old_hi) * 0.5f;
+		vec2 d = (lo + hi) * 0.5f - start;
+
+		// moving less than half its size per substep, the overlap test cannot miss anything
+		if (abs(d.x) < half.x && abs(d.y) < half.y)
+			continue;
+
+		float toi = 1.f;
+		vec2 normal;
+		for (const StaticBox &box : static_boxes)
+		{
+			vec2 box_normal;
+			float t = sweepBox(start, half, d, box, box_normal);
+			if (t < toi)
 			{
-				obj.Vertices[i2].pos.x = MAX_X_COORD;
+				toi = t;
+				normal = box_normal;
 			}
 		}
+		if (toi >= 1.f)
+			continue;
 
-		// can only remove after all vertex of an obj has been looped through
-		if (toRemove != nullptr)
+		vec2 correction = d * (toi - 1.f) - normal * CCD_SKIN;
+		for (int k = 0; k < obj.VertexCount; k++)
 		{
-			// printf("removed");
+			vec2 velocity = obj.Vertices[k].pos - obj.Vertices[k].oldPos;
+			obj.Vertices[k].pos += correction;
 
-			registry.remove_all_components_of(*toRemove);
+			float into = dot(velocity, normal);
+			if (into < 0.f)
+				velocity -= normal * into;
+			obj.Vertices[k].oldPos = obj.Vertices[k].pos - velocity;
 		}
 	}
 }
 
-void updateAllMotionInfo()
+// Substeps for the next fixed step, enough that no body moves more than half of the
+// thinnest collider in one of them. The ccd bodies are still swept past max_substeps.
+int chooseSubsteps(float step_ms, int min_substeps, int max_substeps)
 {
+	float max_move = 0.f;
+	float thinnest = FLT_MAX;
+	for (uint i = 0; i < registry.physObjs.size(); i++)
+	{
+		physObj &obj = registry.physObjs.components[i];
 
+		for (int k = 0; k < obj.EdgesCount; k++)
+			thinnest = min(thinnest, obj.Edges[k].len);
+		if (obj.radius > 0.f)
+			thinnest = min(thinnest, 2.f * obj.radius);
+
+		if (!obj.moveable || !isMoving(obj))
+			continue;
+		for (int k = 0; k < obj.VertexCount; k++)
+			max_move = max(max_move, length(obj.Vertices[k].pos - obj.Vertices[k].oldPos));
+	}
+	if (thinnest == FLT_MAX)
+		return min_substeps;
+
+	float max_speed = max_move / last_substep_ms;
+	int substeps = (int)ceil(max_speed * step_ms / (0.5f * thinnest));
+	return std::max(min_substeps, std::min(substeps, max_substeps));
+}
+
+// Anything that pushed a sleeping body since the last substep (dash, tractor beam, AI) wakes it
+void wakeAccelerated()
+{
 	for (uint i = 0; i < registry.physObjs.size(); i++)
 	{
-		Entity &obj = registry.physObjs.entities[i];
+		physObj &obj = registry.physObjs.components[i];
+		if (obj.state != BODY_STATE::SLEEPING)
+			continue;
+
+		for (int k = 0; k < obj.VertexCount; k++)
+		{
+			if (obj.Vertices[k].accel != vec2(0.f))
+			{
+				wake(obj);
+				break;
+			}
+		}
+	}
+}
+
+// Bodies touching each other form an island, it falls asleep once all of its bodies stayed slow for
+// long enough and they stop where they are. A body that is not ready wakes the whole island, so a
+// stack does not keep sleeping on a body that started to move. Static and kinematic bodies take no
+// part, they would join everything resting on them.
+std::vector<unsigned int> island_parent; // union-find over the body indices
+std::vector<char> island_awake; // by island root
+
+unsigned int islandRoot(unsigned int body)
+{
+	while (island_parent[body] != body)
+	{
+		island_parent[body] = island_parent[island_parent[body]];
+		body = island_parent[body];
+	}
+	return body;
+}
+
+bool inIsland(const physObj &obj)
+{
+	return obj.state == BODY_STATE::DYNAMIC || obj.state == BODY_STATE::SLEEPING;
+}
+
+void updateSleeping(float dt)
+{
+	float max_move = SLEEP_SPEED * dt;
+	unsigned int count = (unsigned int)registry.physObjs.size();
+	island_parent.resize(count);
+	island_awake.assign(count, 0);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		island_parent[i] = i;
+		physObj &obj = registry.physObjs.components[i];
+		if (obj.state != BODY_STATE::DYNAMIC)
+			continue;
+
+		bool still = true;
+		for (int k = 0; k < obj.VertexCount && still; k++)
+			still = length(obj.Vertices[k].pos - obj.Vertices[k].oldPos) < max_move;
+		obj.stillSteps = still ? obj.stillSteps + 1 : 0;
+	}
+
+	// the contacts of this substep, sleeping pairs keep what they found before falling asleep
+	const std::vector<SweepAndPrune::Pair> &pairs = pinball_broadphase.pairs();
+	for (size_t i = 0; i < pairs.size(); i++)
+	{
+		if (!pair_entries[i].touching)
+			continue;
+		if (!inIsland(registry.physObjs.components[pairs[i].a]) || !inIsland(registry.physObjs.components[pairs[i].b]))
+			continue;
+		island_parent[islandRoot(pairs[i].a)] = islandRoot(pairs[i].b);
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const physObj &obj = registry.physObjs.components[i];
+		if (obj.state == BODY_STATE::DYNAMIC && obj.stillSteps < SLEEP_STEPS)
+			island_awake[islandRoot(i)] = 1;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		physObj &obj = registry.physObjs.components[i];
+		bool awake = island_awake[islandRoot(i)];
+		if (obj.state == BODY_STATE::SLEEPING && awake)
+		{
+			wake(obj);
+		}
+		else if (obj.state == BODY_STATE::DYNAMIC && !awake)
+		{
+			obj.state = BODY_STATE::SLEEPING;
+			for (int k = 0; k < obj.VertexCount; k++)
+				obj.Vertices[k].oldPos = obj.Vertices[k].pos;
+		}
+	}
+}
+
+void countBodies()
+{
+	pinball_physics_stats.active = 0;
+	pinball_physics_stats.sleeping = 0;
+	pinball_physics_stats.static_bodies = 0;
+	for (const physObj &obj : registry.physObjs.components)
+	{
+		if (obj.state == BODY_STATE::STATIC)
+			pinball_physics_stats.static_bodies++;
+		else if (obj.state == BODY_STATE::SLEEPING)
+			pinball_physics_stats.sleeping++;
+		else
+			pinball_physics_stats.active++;
+	}
+}
 
-		float x = registry.physObjs.get(obj).Vertices[1].pos.x - registry.physObjs.get(obj).Vertices[0].pos.x;
-		float y = registry.physObjs.get(obj).Vertices[1].pos.y - registry.physObjs.get(obj).Vertices[0].pos.y;
+float bodyAngle(const physObj &obj)
+{
+	// circles do not turn
+	if (obj.VertexCount < 2)
+		return 0.f;
+	float x = obj.Vertices[1].pos.x - obj.Vertices[0].pos.x;
+	float y = obj.Vertices[1].pos.y - obj.Vertices[0].pos.y;
+	return atan2(y, x);
+}
 
-		registry.motions.get(obj).position = registry.physObjs.get(obj).center;
+void storePreviousStates()
+{
+	for (uint i = 0; i < registry.physObjs.size(); i++)
+	{
+		physObj &obj = registry.physObjs.components[i];
 
-		//		printf("%f \n",registry.motions.get(obj).position.y);
-		registry.motions.get(obj).angle = atan2(y, x);
-		//		printf("angle = %f \n", atan2(y, x));
+		obj.prevCenter = obj.center;
+		obj.prevAngle = bodyAngle(obj);
 	}
 }
 
+// alpha is how far the render time is between the last two fixed steps
+void updateAllMotionInfo(float alpha)
+{
+	registry.view<physObj, Motion>().each([alpha](Entity, physObj& obj, Motion& motion)
+	{
+		// take the short way around so a body crossing +-pi does not spin
+		float angle = bodyAngle(obj);
+		float delta = angle - obj.prevAngle;
+		if (delta > M_PI)
+			delta -= 2.f * M_PI;
+		else if (delta < -M_PI)
+			delta += 2.f * M_PI;
+
+		motion.position = mix(obj.prevCenter, obj.center, alpha);
+		motion.angle = obj.prevAngle + delta * alpha;
+	});
+}
+
 void flipperConstraints()
 {
 
@@ -600,53 +1315,88 @@ void flipperConstraints()
 	//}
 }
 
-void update(float dt)
+void update(float dt, WorkerPool &workers, bool cache_contacts)
 {
 
-	applyObjGrav();
+	wakeAccelerated();
+	applyObjGrav(dt);
 	updateAllObjPos(dt);
+	sweepFastBodies();
 	Entity &flipper = registry.playerFlippers.entities[0];
 
 	flipperConstraints();
 	physObj &flipperPhys = registry.physObjs.get(flipper);
-	applyGlobalConstraints();
-	updateAllEdges();
+	applyGlobalConstraints(dt);
+	updateAllEdges(workers);
 	flipperPhys = registry.physObjs.get(flipper);
 	updateAllCenters();
 	flipperPhys = registry.physObjs.get(flipper);
-	detectAndSolveAllCollisions();
-	flipperPhys = registry.physObjs.get(flipper);
-
-	updateAllMotionInfo();
-
+	detectAndSolveAllCollisions(workers, cache_contacts);
 	flipperPhys = registry.physObjs.get(flipper);
+	updateSleeping(dt);
 }
 
-void updateWithSubstep(float dt, float steps)
+void PhysicsSystem::stepFixed(float elapsed_ms)
 {
+	// focus slows the whole simulation down by feeding it less time, the step size stays the same
+	float slowdown = 1.0f;
+	if (registry.pinballPlayerStatus.components[0].focusTimer != 0.0f) {
+		slowdown = 0.1f;
+	}
+	accumulator_ms += elapsed_ms * slowdown;
+	pinball_physics_stats.substeps = 0;
 
-
-	if (dt > 100.f)
+	int steps = 0;
+	while (accumulator_ms >= fixed_step_ms && steps < max_steps_per_frame)
 	{
-		dt = 5.f;
+		storePreviousStates();
+		int substeps = chooseSubsteps(fixed_step_ms, min_substeps, max_substeps);
+		for (int i = 0; i < substeps; i++)
+			update(fixed_step_ms / substeps, workers, cache_contacts);
+		pinball_physics_stats.substeps += substeps;
+		accumulator_ms -= fixed_step_ms;
+		steps++;
 	}
-	for (int i = 0; i < steps; i++)
-	{
-		float slowdown = 1.0f;
 
-		if (registry.pinballPlayerStatus.components[0].focusTimer != 0.0f) {
-			slowdown = 0.1f;
-		}
-		update(dt*slowdown / steps);
-	}
+	// a long frame (loading, dragging the window) drops the time it could not simulate
+	// instead of trying to catch up over the next frames
+	if (accumulator_ms >= fixed_step_ms)
+		accumulator_ms = fmod(accumulator_ms, fixed_step_ms);
+
+	updateAllMotionInfo(accumulator_ms / fixed_step_ms);
+	countBodies();
 }
 
-void PhysicsSystem::step(float elapsed_ms)
+void PhysicsSystem::reset()
 {
+	accumulator_ms = 0.f;
+	contact_cache.clear();
+	pinball_broadphase.clear();
+	last_substep_ms = REF_STEP_MS;
+}
 
-	updateWithSubstep(elapsed_ms, 6.0f);
+void PhysicsSystem::step(float elapsed_ms)
+{
+	// removed bodies leave holes in the vertex pool, pack it once they take up half of it
+	size_t live_vertices = 0;
+	for (const physObj &obj : registry.physObjs.components)
+		live_vertices += obj.VertexCount;
+	if (phys_pool.pos.size() > 2 * live_vertices + 64)
+		phys_pool.compact(registry.physObjs.components);
+
+	stepFixed(elapsed_ms);
 	float step_seconds = elapsed_ms / 1000.f;
 
+	// boxes of the settled bodies for the gameplay queries until the next step
+	pinball_query.clear();
+	for (uint i = 0; i < registry.physObjs.size(); i++)
+	{
+		physObj &obj = registry.physObjs.components[i];
+		vec2 lo, hi;
+		bodyBounds(obj, obj.Vertices.pos(), lo, hi);
+		pinball_query.insert(registry.physObjs.entities[i], lo, hi, obj.center);
+	}
+
 	auto &motion_container = registry.motions;
 	for (uint i = 0; i < motion_container.size(); i++)
 	{
@@ -680,7 +1430,7 @@ void PhysicsSystem::step(float elapsed_ms)
 		}
 		else
 		{
-			registry.remove_all_components_of(entity);
+			command_buffer.destroy(entity);
 		}
 	}
 }
@@ -690,12 +1440,17 @@ void PhysicsSystem::step_world(float elapsed_ms)
 	// Move fish based on how much time has passed, this is to (partially) avoid
 	// having entities move at different speed based on the machine.
 	auto &motion_container = registry.motions;
+	float step_seconds = elapsed_ms / 1000.f;
+
+	world_movers.clear();
 	for (uint i = 0; i < motion_container.size(); i++)
 	{
-		// !!! TODO A1: update motion.position based on step_seconds and motion.velocity
 		Motion &motion = motion_container.components[i];
-		// Entity entity = motion_container.entities[i];
-		float step_seconds = elapsed_ms / 1000.f;
+
+		// the player and the enemies walk through the room, remember where they started
+		Entity entity_i = motion_container.entities[i];
+		if (registry.players.has(entity_i) || registry.mainWorldEnemies.has(entity_i))
+			world_movers.push_back({ i, motion.position });
 
 		// 2a, 2d: separate velocity components and calculate based on angle
 		float v_x = motion.velocity.x * cos(motion.angle) + motion.velocity.y * sin(motion.angle);
@@ -703,54 +1458,14 @@ void PhysicsSystem::step_world(float elapsed_ms)
 		vec2 velocity = {v_x, v_y};
 
 		motion.position += velocity * step_seconds;
+	}
 
-		// Boundary check
-		// Now we restrict everything, but we can choose what we want to restrict
-
-		/*if (motion.position.x < 0)
-		{
-			motion.position.x = 0;
-		}
-		if (motion.position.y < 0)
-		{
-			motion.position.y = 0;
-		}
-		if (motion.position.x > window_width_px)
-		{
-			motion.position.x = window_width_px;
-		}
-		if (motion.position.y > window_height_px)
-		{
-			motion.position.y = window_height_px;
-		}*/
-
-		//// Bounce of side walls
-
-		// if (motion.position.x < 0) {
-		//	vec2 curr_v = motion.velocity;
-		//	motion.position.x = 20;
-		//	motion.velocity = vec2(-curr_v.x, curr_v.y);
-		// }
-		// if (motion.position.y < 0) {
-		//	vec2 curr_v = motion.velocity;
-		//	motion.position.y = 20;
-		//	motion.velocity = vec2(curr_v.x, -curr_v.y);
-		// }
-		// if (motion.position.x > window_width_px) {
-		//	vec2 curr_v = motion.velocity;
-		//	motion.position.x = window_width_px - 20;
-		//	motion.velocity = vec2(-curr_v.x, curr_v.y);
-		// }
-		// if (motion.position.y > window_height_px) {
-		//	vec2 curr_v = motion.velocity;
-		//	motion.position.y = window_height_px - 20;
-		//	motion.velocity = vec2(curr_v.x, -curr_v.y);
-		// }
-
-		//// Gravity
-		// if (registry.balls.has(motion_container.entities[i])) {
-		//	motion.velocity.y += step_seconds * 200;
-		// }
+	// and then stop them at the walls of the room, cell by cell so fast ones cannot skip a wall
+	for (const std::pair<unsigned int, vec2> &mover : world_movers)
+	{
+		Motion &motion = motion_container.components[mover.first];
+		vec2 half = get_bounding_box(motion) / 2.f;
+		motion.position = room_tiles.sweep(mover.second, motion.position, half, motion.velocity);
 	}
 
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -758,59 +1473,47 @@ void PhysicsSystem::step_world(float elapsed_ms)
 	// DON'T WORRY ABOUT THIS UNTIL ASSIGNMENT 2
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
-	// Check for collisions between all moving entities
+	// Check for collisions between all entities with a collider, the grid only hands out pairs that are
+	// close and the layers drop the pairs that never interact before the actual test
+	world_grid.clear();
 	for (uint i = 0; i < motion_container.components.size(); i++)
 	{
-		Motion &motion_i = motion_container.components[i];
 		Entity entity_i = motion_container.entities[i];
+		if (!registry.colliderLayers.has(entity_i))
+			continue;
 
-		if (!registry.rooms.has(entity_i) && !registry.healthBar.has(entity_i))
+		// collides() tests the centers against the bounding box circles
+		const Motion &motion_i = motion_container.components[i];
+		float radius = length(get_bounding_box(motion_i) / 2.f);
+		world_grid.insert(i, motion_i.position - radius, motion_i.position + radius);
+	}
+	world_grid.collect_pairs(world_pairs);
+
+	world_contacts.clear();
+	world_contacts.reserve((unsigned int)world_pairs.size());
+	collision_stats = CollisionStats();
+	collision_stats.candidates = (int)world_pairs.size();
+	for (const SpatialHash::Pair &pair : world_pairs)
+	{
+		Entity entity_i = motion_container.entities[pair.first];
+		Entity entity_j = motion_container.entities[pair.second];
+		if (!registry.colliderLayers.get(entity_i).accepts(registry.colliderLayers.get(entity_j)))
 		{
-			// note starting j at i+1 to compare all (i,j) pairs only once (and to not compare with itself)
-			for (uint j = i + 1; j < motion_container.components.size(); j++)
-			{
-				Motion &motion_j = motion_container.components[j];
-				if (collides(motion_i, motion_j))
-				{
-					Entity entity_j = motion_container.entities[j];
-
-					//// ball vs player collision
-					// if (registry.balls.has(entity_i) && registry.players.has(entity_j) ||
-					//	registry.balls.has(entity_j) && registry.players.has(entity_i)) {
-
-					//	// Split them apart first
-					//	vec2 dp = motion_i.position - motion_j.position;
-					//	float dist = length(dp);
-					//	float radius_sum = (abs(motion_i.scale.x) + abs(motion_j.scale.x)) / 2.f;
-					//	float displacement = (radius_sum - dist) / 2.f + 0.00001;
-					//	motion_i.position += displacement * normalize(dp);
-					//	motion_j.position -= displacement * normalize(dp);
-
-					//	// Velocity Calculation
-					//	if (registry.balls.has(entity_i)) {
-					//		motion_i.velocity -= (2) * dot(
-					//			(motion_i.velocity - motion_j.velocity), (motion_i.position - motion_j.position)
-					//		) / length(motion_i.position - motion_j.position) / length(motion_i.position - motion_j.position)
-					//			* (motion_i.position - motion_j.position);
-					//	}
-					//	else {
-					//		motion_j.velocity -= (2) * dot(
-					//			(motion_j.velocity - motion_i.velocity), (motion_j.position - motion_i.position)
-					//		) / length(motion_j.position - motion_i.position) / length(motion_j.position - motion_i.position)
-					//			* (motion_j.position - motion_i.position);
-					//	}
-					//}
-
-					// else {
-					//  Create a collisions event
-					//  We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
-					if (!registry.rooms.has(entity_j) && !registry.healthBar.has(entity_j)) {
-						registry.collisions.emplace_with_duplicates(entity_i, entity_j);
-					    registry.collisions.emplace_with_duplicates(entity_j, entity_i);
-					}
-					//}
-				}
-			}
+			collision_stats.rejected_by_layer++;
+			continue;
+		}
+
+		const Motion &motion_i = motion_container.components[pair.first];
+		const Motion &motion_j = motion_container.components[pair.second];
+		if (collides(motion_i, motion_j))
+		{
+			// Same circles as collides(), the normal points from j towards i
+			vec2 dp = motion_i.position - motion_j.position;
+			float dist = length(dp);
+			float radius = max(length(get_bounding_box(motion_i) / 2.f), length(get_bounding_box(motion_j) / 2.f));
+			vec2 normal = dist > 0.f ? dp / dist : vec2(0.f, 1.f);
+			world_contacts.push(entity_i, entity_j, normal, radius - dist);
+			collision_stats.events++;
 		}
 	}
 
@@ -4,6 +4,9 @@
 #include "tiny_ecs.hpp"
 #include "components.hpp"
 #include "tiny_ecs_registry.hpp"
+#include "physics_kernels.hpp"
+#include "spatial_hash.hpp"
+#include "worker_pool.hpp"
 
 // A simple physics system that moves rigid bodies and checks for collision
 class PhysicsSystem
@@ -11,9 +14,45 @@ class PhysicsSystem
 public:
 	void step(float elapsed_ms);
 	void step_world(float elapsed_ms);
-	
+
+	// the pinball bodies always advance by this much, the interpolation runs between these steps
+	float fixed_step_ms = 1000.f / 120.f;
+	// any more than this in one frame is dropped, the game slows down rather than spiralling
+	int max_steps_per_frame = 6;
+	// each fixed step is split by how fast the fastest body moves, min_substeps keeps the calm
+	// frames at 240 Hz, the old fixed 6 per frame was 360 Hz
+	int min_substeps = 2;
+	int max_substeps = 8;
+	// keep the pinball contacts between substeps for the separating axis early-out and the warm
+	// start, only turned off to compare against in contact_cache_bench
+	bool cache_contacts = true;
+	// threads of the pinball solver including the caller, 0 picks one per hardware thread
+	void set_solver_threads(int threads) { workers.set_threads(threads); }
+	// forget what the pinball solver carried over between steps (the unsimulated time, the cached
+	// contacts, the broadphase order and the last substep length), for a board built from scratch
+	void reset();
+
+private:
+	// time not yet simulated, always less than one fixed step after step()
+	float accumulator_ms = 0.f;
+
+	void stepFixed(float elapsed_ms);
+
+	// motion indices of the player and the enemies with their positions before the update
+	std::vector<std::pair<unsigned int, vec2>> world_movers;
+
+	// threads of the pinball edge relaxation and narrowphase, the step thread is one of them
+	WorkerPool workers;
+
+	// broadphase of the world mode collisions and the candidate pairs it found
+	SpatialHash world_grid;
+	std::vector<SpatialHash::Pair> world_pairs;
+
+public:
 
 	PhysicsSystem()
 	{
+		// single threaded until physics_threads_bench shows the pool pays off on multi-core machines
+		workers.set_threads(1);
 	}
 };
\ No newline at end of file
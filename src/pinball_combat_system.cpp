@@ -0,0 +1,155 @@
+// internal
+#include "pinball_combat_system.hpp"
+
+// stlib
+#include <algorithm>
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+#include <SDL_mixer.h>
+
+float COMBO_DAMAGE_MULTIPLIER = 0.01f;
+
+namespace {
+    // What a pinball body is as far as contact reactions are concerned
+    enum PINBALL_CONTACT_KIND {
+        PINBALL_ENEMY = 0,
+        PINBALL_PROJECTILE = 1, // anything that deals damage to enemies
+        PINBALL_OTHER = 2,
+        PINBALL_KIND_COUNT = 3
+    };
+
+    PINBALL_CONTACT_KIND contact_kind(Entity e) {
+        if (registry.pinballEnemies.has(e))
+            return PINBALL_ENEMY;
+        if (registry.attackPower.has(e))
+            return PINBALL_PROJECTILE;
+        return PINBALL_OTHER;
+    }
+
+    unsigned int handle(Entity e) {
+        return (unsigned int)e;
+    }
+}
+
+void PinballCombatSystem::unique_pairs(const ContactStream &stream, std::vector<Contact> &out) {
+    // The solver reports a pair in both orientations and once per substep, keep the first report of
+    // each pair, in the order the contacts were recorded
+    keys.clear();
+    for (const Contact &c : stream) {
+        unsigned long long lo = std::min(handle(c.a), handle(c.b));
+        unsigned long long hi = std::max(handle(c.a), handle(c.b));
+        keys.push_back({(lo << 32) | hi, (unsigned int)keys.size()});
+    }
+    std::sort(keys.begin(), keys.end());
+
+    first.clear();
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (i == 0 || keys[i].first != keys[i - 1].first)
+            first.push_back(keys[i].second);
+    }
+    std::sort(first.begin(), first.end());
+
+    out.clear();
+    for (unsigned int i : first)
+        out.push_back(stream.begin()[i]);
+}
+
+void PinballCombatSystem::step() {
+    // Reactions by the kinds of the two bodies, nullptr if they don't care about each other
+    typedef void (PinballCombatSystem::*ContactHandler)(Entity, Entity);
+    static const ContactHandler handlers[PINBALL_KIND_COUNT][PINBALL_KIND_COUNT] = {
+        // PINBALL_ENEMY                        PINBALL_PROJECTILE                     PINBALL_OTHER
+        { nullptr,                              &PinballCombatSystem::on_enemy_hit,    nullptr }, // PINBALL_ENEMY
+        { nullptr,                              nullptr,                               nullptr }, // PINBALL_PROJECTILE
+        { nullptr,                              nullptr,                               nullptr }, // PINBALL_OTHER
+    };
+
+    unique_pairs(pinball_contacts, hits);
+    pinball_contacts.clear();
+    for (const Contact &contact : hits) {
+        // the bodies may have been removed since the contact was recorded
+        if (!registry.physObjs.has(contact.a) || !registry.physObjs.has(contact.b))
+            continue;
+        Entity a = contact.a;
+        Entity b = contact.b;
+        if (contact_kind(a) > contact_kind(b))
+            std::swap(a, b);
+        ContactHandler handler = handlers[contact_kind(a)][contact_kind(b)];
+        if (handler)
+            (this->*handler)(a, b);
+    }
+
+    // Floor contacts have the body as both a and b
+    unique_pairs(pinball_floor_contacts, floor_hits);
+    pinball_floor_contacts.clear();
+    for (const Contact &contact : floor_hits) {
+        if (registry.physObjs.has(contact.a))
+            on_floor_hit(contact.a);
+    }
+}
+
+// Damage an enemy hit by a projectile
+void PinballCombatSystem::on_enemy_hit(Entity enemy, Entity projectile) {
+    PinBallEnemy &pinballEnemy = registry.pinballEnemies.get(enemy);
+    if (pinballEnemy.invincibilityTimer == 0) {
+        float damage =
+                registry.attackPower.get(projectile).damage * (1 + COMBO_DAMAGE_MULTIPLIER * registry.pinballPlayerStatus.components[0].comboCounter);
+
+        pinballEnemy.currentHealth = pinballEnemy.currentHealth - damage < 0 ? 0 : pinballEnemy.currentHealth - damage;
+
+        pinballEnemy.invincibilityTimer += 200.0f;
+
+        Mix_PlayChannel(-1, registry.sfx.components[0].enemy_hit_sound, 0);
+
+        // ticking up combo
+        registry.pinballPlayerStatus.components[0].comboCounter++;
+        if (debugging.in_debug_mode)
+            printf("Combo = %i ", registry.pinballPlayerStatus.components[0].comboCounter);
+
+        // deducting hits left for temp projectile
+        if (registry.temporaryProjectiles.has(projectile)) {
+            if (!registry.temporaryProjectiles.get(projectile).bonusBall) {
+                if (registry.temporaryProjectiles.get(projectile).hitsLeft - 1 <= 0) {
+                    command_buffer.destroy(projectile);
+                } else {
+                    registry.temporaryProjectiles.get(projectile).hitsLeft--;
+                }
+            }
+        }
+    }
+}
+
+// Damage the player when an enemy projectile reaches the bottom of the board
+void PinballCombatSystem::on_floor_hit(Entity projectile) {
+    PinballPlayerStatus &status = registry.pinballPlayerStatus.components[0];
+    if (status.invincibilityTimer == 0.0f) {
+        float dmg = registry.damages.get(projectile).damage;
+        if (status.health < dmg) {
+            status.health = 0.0;
+        } else {
+            status.health -= dmg;
+        }
+        status.invincibilityTimer += 500.0f;
+        if (debugging.in_debug_mode)
+            printf("PlayerHealth = %f ", status.health);
+
+        Mix_PlayChannel(-1, registry.sfx.components[0].player_hit_sound, 0);
+
+        // reset combo
+        status.comboCounter = 0;
+        if (debugging.in_debug_mode)
+            printf("Combo = %i ", status.comboCounter);
+
+        // potential bug in this one
+        if (registry.temporaryProjectiles.has(projectile)) {
+            if (registry.temporaryProjectiles.get(projectile).hitsLeft - 1 <= 0) {
+                command_buffer.destroy(projectile);
+            } else {
+                registry.temporaryProjectiles.get(projectile).hitsLeft--;
+                if (debugging.in_debug_mode)
+                    printf("hits = %i ", registry.temporaryProjectiles.get(projectile).hitsLeft);
+            }
+        }
+    }
+}
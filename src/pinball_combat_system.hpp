@@ -0,0 +1,27 @@
+#pragma once
+
+// internal
+#include "common.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "contact_stream.hpp"
+
+// Gameplay reactions to the contacts recorded by the pinball physics: enemy damage, combo, invincibility,
+// sounds and projectile hit counts. The solver only records contacts while it runs its substeps, this
+// system consumes them once per frame after the physics step, each pair at most once.
+class PinballCombatSystem
+{
+public:
+    void step();
+
+private:
+    void on_enemy_hit(Entity enemy, Entity projectile);
+    void on_floor_hit(Entity projectile);
+
+    // scratch, contacts of this frame with one entry per pair
+    std::vector<Contact> hits;
+    std::vector<Contact> floor_hits;
+    std::vector<std::pair<unsigned long long, unsigned int>> keys;
+    std::vector<unsigned int> first;
+
+    void unique_pairs(const ContactStream &stream, std::vector<Contact> &out);
+};
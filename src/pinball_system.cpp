@@ -6,10 +6,13 @@
 #include <cassert>
 #include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <ctime>
 
 #include "physics_system.hpp"
 #include "world_system.hpp"
 #include "swarm_system.hpp"
+#include "spatial_query.hpp"
 
 #include "imgui.h"
 
@@ -32,7 +35,7 @@ RenderSystem* r;
 float DASH_STRENTH = 0.2f;
 
 PinballSystem::PinballSystem() {
-   auto curr_level = Entity();
+   auto curr_level = Entity::create();
    CombatLevel combatLevel = {1};
    registry.combatLevel.emplace(curr_level, combatLevel);
    this->swarmSystem = SwarmSystem(renderer);
@@ -71,7 +74,7 @@ void PinballSystem::redirect_inputs_pinball() {
 
 // had to copy accelerateObj here since I don't know if creating a instance of physics system to call the function would cause performance issues
 
-void accelerate2(vec2 acc, Vertex_Phys& obj)
+void accelerate2(vec2 acc, Vertex_Phys obj)
 {
     obj.accel += acc;
 }
@@ -104,14 +107,15 @@ void pinballDash() {
         float minDist = 1000.0f;
         vec2 direction = vec2(0.0f, 1.0f);
 
-        for (int i = 0; i < registry.pinballEnemies.components.size(); i++) {
-            Entity enemy = registry.pinballEnemies.entities[i];
-            float dist = distance(registry.physObjs.get(enemy).center, pinballPhys.center);
-
-            if (dist < minDist) {
-                minDist = dist;
-                direction = normalize(vec2(registry.physObjs.get(enemy).center.x - pinballPhys.center.x,
-                    registry.physObjs.get(enemy).center.y - pinballPhys.center.y));
+        // closest enemy body as of the last physics step
+        std::vector<Entity> nearest;
+        pinball_query.nearest(pinballPhys.center, 1, nearest, [](Entity e) {
+            return registry.pinballEnemies.has(e) && registry.physObjs.has(e);
+        });
+        if (!nearest.empty()) {
+            vec2 target = registry.physObjs.get(nearest[0]).center;
+            if (distance(target, pinballPhys.center) < minDist) {
+                direction = normalize(target - pinballPhys.center);
             }
         }
 
@@ -126,7 +130,7 @@ void tractorStep() {
 
         physObj& pinballPhys = registry.physObjs.get(registry.pinballPlayerStatus.entities[0]);
 
-        physObj flipper = registry.physObjs.get(registry.playerFlippers.entities[0]);
+        const physObj& flipper = registry.physObjs.get(registry.playerFlippers.entities[0]);
 
 
         vec2 direction = vec2(0.0f, 1.0f);
@@ -194,7 +198,7 @@ void updateTimers(float ms) {
         for (int i = 0; i < registry.temporaryProjectiles.components.size(); i++) {
             countdown(registry.temporaryProjectiles.components[i].timeLeft, ms);
             if (registry.temporaryProjectiles.components[i].timeLeft == 0 && !registry.temporaryProjectiles.components[i].bonusBall) {
-                registry.remove_all_components_of(registry.temporaryProjectiles.entities[i]);
+                command_buffer.destroy(registry.temporaryProjectiles.entities[i]);
             }
         }
 
@@ -215,11 +219,10 @@ void PinballSystem::stepEnemyAttack() {
 
                 PinBall& pinball = registry.pinBalls.components[0];
 
-                physObj enemyObj = registry.physObjs.get(registry.pinballEnemies.entities[i]);
+                const physObj& enemyObj = registry.physObjs.get(registry.pinballEnemies.entities[i]);
                 vec2 spawnPos = vec2(enemyObj.center.x, enemyObj.center.y + 50.0f);
 
                 Entity projectile_ball = createBall(r, spawnPos, pinball.pinBallSize, 0.f);
-                createNewRectangleTiedToEntity(projectile_ball, pinball.pinBallSize, pinball.pinBallSize, registry.motions.get(projectile_ball).position, true, 1);
                 registry.colors.insert(projectile_ball, { 1.f, 0.f, 0.f});
 
                 TemporaryProjectile temp;
@@ -284,7 +287,7 @@ bool PinballSystem::step(float elapsed_ms_since_last_update) {
             int numParticles = registry.pinBalls.components[0].pinBallSize;
             for (Entity entity: registry.balls.entities) {
                 if (registry.balls.get(entity).trail>0.f) {
-                physObj ball = registry.physObjs.get(entity);
+                const physObj& ball = registry.physObjs.get(entity);
                 vec2 center = {0.f, 0.f};
                 for (int i=0; i<ball.VertexCount; i++) {
                     center+=ball.Vertices[i].pos;
@@ -320,19 +323,19 @@ bool PinballSystem::step(float elapsed_ms_since_last_update) {
             PinBallEnemy &enemy = registry.pinballEnemies.get(entity);
             if (enemy.currentHealth <= 0) {
                 for (int j = 0; j < enemy.healthBar.size(); j++) {
-                    registry.remove_all_components_of(enemy.healthBar[j]);
+                    command_buffer.destroy(enemy.healthBar[j]);
                 }
 
                 if (registry.swarmKing.has(entity)) {
                     for (Entity se: registry.swarmEnemies.entities) {
-                        registry.remove_all_components_of(se);
+                        command_buffer.destroy(se);
                     }
 //                    delete swarmSystem;
                 }
 
                 Mix_PlayChannel(-1, registry.sfx.components[0].enemy_death_sound, 0);
 
-                registry.remove_all_components_of(entity);
+                command_buffer.destroy(entity);
             }
         }
 
@@ -428,6 +431,25 @@ void PinballSystem::on_key(int key, int, int action, int mod) {
         }
     }
 
+    // hold D and press V to check the vectorised SAT projections against the scalar ones
+    if (debugging.in_debug_mode && action == GLFW_RELEASE && key == GLFW_KEY_V)
+    {
+        int mismatches = check_project_gaps(100000, (unsigned int)time(nullptr));
+        printf("project_gaps: %d mismatches in 100000 random polygon pairs\n", mismatches);
+    }
+
+    // developer quick-save and rollback of the combat scene, hold D and press F5 or F9
+    if (debugging.in_debug_mode && action == GLFW_RELEASE && (key == GLFW_KEY_F5 || key == GLFW_KEY_F9))
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        if (key == GLFW_KEY_F5)
+            quick_save = registry.snapshot();
+        else if (!quick_save.empty())
+            registry.restore(quick_save);
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        printf("%s registry (%zu bytes) in %.3f ms\n", key == GLFW_KEY_F5 ? "Saved" : "Restored", quick_save.size(), ms);
+    }
+
     //// Resetting game
     //if (action == GLFW_RELEASE && key == GLFW_KEY_R)
     //{
@@ -511,7 +533,6 @@ void PinballSystem::on_key(int key, int, int action, int mod) {
 
             PinBall& pinBall = registry.pinBalls.components[0];
             Entity projectile_ball = createBall(renderer, spawnPos, pinBall.pinBallSize, 0.f);
-            createNewRectangleTiedToEntity(projectile_ball, pinBall.pinBallSize, pinBall.pinBallSize, registry.motions.get(projectile_ball).position, true, 1);
 
             TemporaryProjectile temp;
             temp.hitsLeft = 1;
@@ -664,6 +685,8 @@ void PinballSystem::start_base_level() {
                                                       {580, 580},
                                                       {580, 600} }, GEOMETRY_BUFFER_ID::RECT);
     createNewRectangleTiedToEntity(flipper, 100.f, 20.f, registry.motions.get(flipper).position, true, 0.0);
+    // the mouse moves it by setting its vertices
+    registry.physObjs.get(flipper).state = BODY_STATE::KINEMATIC;
 
     playerFlipper pf;
     registry.playerFlippers.insert(flipper, pf);
@@ -671,7 +694,6 @@ void PinballSystem::start_base_level() {
     PinBall& pinBall = registry.pinBalls.components[0];
     Entity player_ball = createBall(renderer, { 400, 400 }, pinBall.pinBallSize, 1.f, true);
     //createNewRectangleTiedToEntity(player_ball, 50.f * MonitorScreenRatio, 50.f * MonitorScreenRatio * 1.2f, registry.motions.get(player_ball).position, true, 1);
-    createNewRectangleTiedToEntity(player_ball, pinBall.pinBallSize, pinBall.pinBallSize, registry.motions.get(player_ball).position, true, 1);
 
     // setting up player status for pinball
     PinballPlayerStatus status;
@@ -727,6 +749,8 @@ void PinballSystem::start_test_level() {
                                                       {580, 580},
                                                       {580, 600} }, GEOMETRY_BUFFER_ID::RECT);
     createNewRectangleTiedToEntity(flipper, 100.f, 20.f, registry.motions.get(flipper).position, true, 0.0);
+    // the mouse moves it by setting its vertices
+    registry.physObjs.get(flipper).state = BODY_STATE::KINEMATIC;
 
 
     //enemy
@@ -741,7 +765,6 @@ void PinballSystem::start_test_level() {
     PinBall& pinBall = registry.pinBalls.components[0];
     Entity player_ball = createBall(renderer, { 400, 400 }, pinBall.pinBallSize, 1.f);
     //createNewRectangleTiedToEntity(player_ball, 50.f * MonitorScreenRatio, 50.f * MonitorScreenRatio * 1.2f, registry.motions.get(player_ball).position, true, 1);
-    createNewRectangleTiedToEntity(player_ball, pinBall.pinBallSize, pinBall.pinBallSize, registry.motions.get(player_ball).position, true, 1);
 
 
     // setting up player status for pinball
@@ -865,44 +888,6 @@ void PinballSystem::start_level_3() {
 //    spawn_swarm(boundary);
 }
 
-// Compute collisions between entities
-void PinballSystem::handle_collisions() {
-    // Loop over all collisions detected by the physics system
-    auto &collisionsRegistry = registry.collisions;
-    for (uint i = 0; i < collisionsRegistry.components.size(); i++) {
-        // The entity and its collider
-        Entity entity = collisionsRegistry.entities[i];
-        Entity entity_other = collisionsRegistry.components[i].other_entity;
-
-        // For now, we are only interested in collisions that involve the salmon
-        if (registry.players.has(entity)) {
-            // Player& player = registry.players.get(entity);
-
-            // Checking Player - Room collisions
-            if (registry.rooms.has(entity_other)) {
-                // initiate death unless already dying
-                if (!registry.deathTimers.has(entity)) {
-                    // Scream, reset timer, and make the salmon sink
-                    registry.deathTimers.emplace(entity);
-//                    Mix_PlayChannel(-1, salmon_dead_sound, 0);
-
-                }
-            }
-                // Checking Player - mainWorldEnemies collisions
-            else if (registry.mainWorldEnemies.has(entity_other)) {
-                if (!registry.deathTimers.has(entity)) {
-                    // chew, count points, and set the LightUp timer
-                    registry.remove_all_components_of(entity_other);
-                    // Mix_PlayChannel(-1, player_attack_sound, 0);
-                }
-            }
-        }
-    }
-
-    // Remove all collisions from this simulation step
-    registry.collisions.clear();
-}
-
 void PinballSystem::exit_combat() {
     while (registry.combat.entities.size() > 0)
         registry.remove_all_components_of(registry.combat.entities.back());
@@ -34,9 +34,6 @@ public:
     // Steps the game ahead by ms milliseconds
     bool step(float elapsed_ms);
 
-    // Check for collisions
-    void handle_collisions();
-
     // exit combat
     void exit_combat();
 
@@ -80,6 +77,9 @@ private:
 
     std::unordered_set<int> pressedKeys;
 
+    // registry snapshot taken with F5, restored with F9
+    std::vector<char> quick_save;
+
     // FIXME: moved to swarm_system
 //    void spawn_swarm(vec2 boundary);
 //
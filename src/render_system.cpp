@@ -483,6 +483,8 @@ void RenderSystem::draw_combat_scene() {
         for (PinBallEnemy enemy: registry.pinballEnemies.components) {
             for (int i=0; i<3; i++) {
                 Entity en = enemy.healthBar[i];
+                if (!registry.valid(en))
+                    continue;
                 drawTexturedMesh(en, projection_2D);
             }
         }
@@ -525,6 +527,14 @@ void RenderSystem::draw_combat_scene() {
 
 
     ImGui::End();
+
+    if (debugging.in_debug_mode) {
+        ImGui::Begin("Counters");
+        ImGui::Text("pinball bodies: %d active, %d sleeping, %d static, %d substeps",
+                    pinball_physics_stats.active, pinball_physics_stats.sleeping,
+                    pinball_physics_stats.static_bodies, pinball_physics_stats.substeps);
+        ImGui::End();
+    }
     ImGui::Render();
 
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -613,11 +623,7 @@ void RenderSystem::draw_world(bool &tutorial_open) {
 
     std::vector<Light> lights = {};
 
-    for (Entity entity: registry.lights.entities) {
-        if (!registry.lights.has(entity)) {
-            continue;
-        }
-
+    for (Entity entity: registry.query<Light, RenderRequest, Motion>()) {
         RenderRequest &renderRequest = registry.renderRequests.get(entity);
         Motion &motion = registry.motions.get(entity);
         Light &light = registry.lights.get(entity);
@@ -660,11 +666,8 @@ void RenderSystem::draw_world(bool &tutorial_open) {
         drawTexturedMesh(entity, projection_2D);
     }
 
-    // Draw all textured meshes that have a position and size component
-    for (Entity entity: registry.renderRequests.entities) {
-        if (!registry.motions.has(entity) || registry.combat.has(entity))
-            continue;
-
+    // Draw the shadows of all world meshes that have a position and size component
+    for (Entity entity: registry.query<RenderRequest, Motion>(exclude<Combat>)) {
         RenderRequest &renderRequest = registry.renderRequests.get(entity);
         if (renderRequest.used_texture == TEXTURE_ASSET_ID::GROUND) {
             continue;
@@ -728,10 +731,27 @@ void RenderSystem::draw_world(bool &tutorial_open) {
     if (registry.players.components.size()>0) {
         for (int i=0; i<3; i++) {
             Entity en = registry.players.components[0].healthBar[i];
+            if (!registry.valid(en))
+                continue;
             drawTexturedMesh(en, projection_2D);
         }
     }
 
+    // Per frame counters of the collision check and the cached queries
+    if (debugging.in_debug_mode) {
+        ImGui::Begin("Counters");
+        ImGui::Text("collision pairs: %d candidates, %d rejected by layer, %d events",
+                    collision_stats.candidates, collision_stats.rejected_by_layer, collision_stats.events);
+        for (const std::unique_ptr<Query> &query: registry.cached_queries()) {
+            ImGui::Text("%016llx/%016llx: %d entities, %d incremental, %d rescanned",
+                        query->include, query->exclude, (int)query->size(), query->incremental, query->rescanned);
+        }
+        ImGui::End();
+    }
+    for (const std::unique_ptr<Query> &query: registry.cached_queries()) {
+        query->reset_stats();
+    }
+
     // Truely render to the screen
     drawToScreen();
 
@@ -135,7 +135,7 @@ private:
 	GLuint off_screen_render_buffer_color;
 	GLuint off_screen_render_buffer_depth;
 
-	Entity screen_state_entity;
+	Entity screen_state_entity = Entity::create();
 
     void init_ImGui(GLFWwindow *window_arg) const;
 
@@ -66,6 +66,10 @@ bool RenderSystem::init(GLFWwindow* window_arg)
 	initializeGlEffects();
 	initializeGlGeometryBuffers();
 
+	// meshes are referenced by Mesh* components, snapshots store them by id
+	for (Mesh& mesh : meshes)
+		snapshot_assets.add(&mesh);
+
 	return true;
 }
 
@@ -0,0 +1,119 @@
+// internal
+#include "spatial_hash.hpp"
+
+// stlib
+#include <algorithm>
+#include <cmath>
+
+void SpatialHash::clear()
+{
+	entries.clear();
+	ids.clear();
+	large.clear();
+	sorted = true;
+}
+
+void SpatialHash::sort_entries()
+{
+	if (sorted)
+		return;
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.cell < b.cell; });
+	sorted = true;
+}
+
+void SpatialHash::insert(unsigned int id, vec2 lo, vec2 hi)
+{
+	int x0 = (int)std::floor(lo.x / cell_size);
+	int y0 = (int)std::floor(lo.y / cell_size);
+	int x1 = (int)std::floor(hi.x / cell_size);
+	int y1 = (int)std::floor(hi.y / cell_size);
+
+	ids.push_back(id);
+	if (id >= marks.size())
+		marks.resize(id + 1, mark);
+	if ((long long)(x1 - x0 + 1) * (y1 - y0 + 1) > MAX_CELLS_PER_ITEM)
+	{
+		large.push_back(id);
+		return;
+	}
+
+	for (int cy = y0; cy <= y1; cy++)
+		for (int cx = x0; cx <= x1; cx++)
+			entries.push_back({ key(cx, cy), id });
+	sorted = false;
+}
+
+void SpatialHash::collect_pairs(std::vector<Pair>& out)
+{
+	out.clear();
+
+	sort_entries();
+
+	// Every run of equal cells pairs up all of its items
+	for (size_t begin = 0; begin < entries.size();)
+	{
+		size_t end = begin + 1;
+		while (end < entries.size() && entries[end].cell == entries[begin].cell)
+			end++;
+		for (size_t i = begin; i < end; i++)
+			for (size_t j = i + 1; j < end; j++)
+				out.push_back(std::minmax(entries[i].id, entries[j].id));
+		begin = end;
+	}
+
+	for (unsigned int big : large)
+		for (unsigned int id : ids)
+			if (id != big)
+				out.push_back(std::minmax(big, id));
+
+	// Items sharing several cells are found once per cell
+	std::sort(out.begin(), out.end());
+	out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+void SpatialHash::query(vec2 lo, vec2 hi, std::vector<unsigned int>& out)
+{
+	out.clear();
+	sort_entries();
+
+	// an item in several of the cells is listed once
+	mark++;
+	auto list = [&](unsigned int id)
+	{
+		if (marks[id] != mark)
+		{
+			marks[id] = mark;
+			out.push_back(id);
+		}
+	};
+
+	int x0 = (int)std::floor(lo.x / cell_size);
+	int y0 = (int)std::floor(lo.y / cell_size);
+	int x1 = (int)std::floor(hi.x / cell_size);
+	int y1 = (int)std::floor(hi.y / cell_size);
+
+	if ((double)(x1 - x0 + 1) * (y1 - y0 + 1) > (double)entries.size())
+	{
+		// a box spanning more cells than there are entries is cheaper to answer by a scan
+		for (const Entry& entry : entries)
+		{
+			int cx = key_x(entry.cell);
+			int cy = key_y(entry.cell);
+			if (cx >= x0 && cx <= x1 && cy >= y0 && cy <= y1)
+				list(entry.id);
+		}
+	}
+	else
+	{
+		// the entries of a column of cells are contiguous, x is the high half of the key
+		for (int cx = x0; cx <= x1; cx++)
+		{
+			auto first = std::lower_bound(entries.begin(), entries.end(), key(cx, y0), [](const Entry& entry, unsigned long long cell) { return entry.cell < cell; });
+			for (auto it = first; it != entries.end() && key_x(it->cell) == cx && key_y(it->cell) <= y1; ++it)
+				list(it->id);
+		}
+	}
+
+	for (unsigned int big : large)
+		list(big);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "common.hpp"
+
+// stlib
+#include <utility>
+#include <vector>
+
+// Uniform grid over the plane, items are axis aligned boxes registered in every cell they touch.
+// Rebuilt from scratch whenever the items moved: clear(), insert() all of them, then query.
+// Cells are only materialised for occupied cells, so the grid has no bounds.
+// SpatialQuery answers nearest, radius and ray queries on top of it.
+class SpatialHash
+{
+public:
+	typedef std::pair<unsigned int, unsigned int> Pair;
+
+	explicit SpatialHash(float cell_size = 64.f) : cell_size(cell_size) {}
+
+	void clear();
+
+	// Register item id covering the box [lo, hi]
+	void insert(unsigned int id, vec2 lo, vec2 hi);
+
+	// All pairs (a < b) of items that share at least one cell, sorted and without duplicates.
+	// The boxes of every pair that overlaps are guaranteed to share a cell.
+	void collect_pairs(std::vector<Pair>& out);
+
+	// Ids of the items sharing a cell with the box [lo, hi], without duplicates and in no particular
+	// order. A superset of the items overlapping the box, the caller tests the actual shapes.
+	void query(vec2 lo, vec2 hi, std::vector<unsigned int>& out);
+
+	float cell() const { return cell_size; }
+
+	size_t size() const { return ids.size(); }
+
+private:
+	// Items spanning more cells than this are kept aside and paired with everything
+	enum : int { MAX_CELLS_PER_ITEM = 64 };
+	enum : unsigned int { SIGN = 0x80000000u };
+
+	struct Entry
+	{
+		unsigned long long cell;
+		unsigned int id;
+	};
+
+	float cell_size;
+	std::vector<Entry> entries; // one per occupied (cell, item), sorted by cell when queried
+	std::vector<unsigned int> ids;
+	std::vector<unsigned int> large;
+	bool sorted = true; // entries are sorted by cell, insert() breaks it
+	std::vector<unsigned int> marks; // by id, equal to mark if the current query already listed it
+	unsigned int mark = 0;
+
+	void sort_entries();
+
+	// The sign bits are flipped so the keys sort like the signed coordinates, x first
+	unsigned long long key(int cx, int cy) const
+	{
+		return ((unsigned long long)((unsigned int)cx ^ SIGN) << 32) | ((unsigned int)cy ^ SIGN);
+	}
+	int key_x(unsigned long long cell) const { return (int)((unsigned int)(cell >> 32) ^ SIGN); }
+	int key_y(unsigned long long cell) const { return (int)((unsigned int)cell ^ SIGN); }
+};
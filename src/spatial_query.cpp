@@ -0,0 +1,57 @@
+// internal
+#include "spatial_query.hpp"
+
+// stlib
+#include <algorithm>
+
+SpatialQuery pinball_query;
+
+void SpatialQuery::clear()
+{
+	grid.clear();
+	items.clear();
+}
+
+void SpatialQuery::insert(Entity entity, vec2 lo, vec2 hi, vec2 center)
+{
+	if (items.empty())
+	{
+		bounds_lo = lo;
+		bounds_hi = hi;
+	}
+	bounds_lo = min(bounds_lo, lo);
+	bounds_hi = max(bounds_hi, hi);
+
+	grid.insert((unsigned int)items.size(), lo, hi);
+	items.push_back({ entity, lo, hi, center });
+}
+
+void SpatialQuery::nearest(vec2 pos, int k, std::vector<Entity>& out, const Filter& accept)
+{
+	out.clear();
+	if (k <= 0 || items.empty())
+		return;
+
+	// Grow the radius until it holds k centers, those are then the k nearest. reach covers all items.
+	float reach = length(max(abs(pos - bounds_lo), abs(pos - bounds_hi)));
+	for (float radius = grid.cell();; radius *= 2.f)
+	{
+		radius = min(radius, reach);
+		grid.query(pos - radius, pos + radius, candidates);
+
+		ranked.clear();
+		for (unsigned int id : candidates)
+		{
+			vec2 d = items[id].center - pos;
+			if (dot(d, d) <= radius * radius && accepted(items[id], accept))
+				ranked.push_back({ dot(d, d), id });
+		}
+		if ((int)ranked.size() >= k || radius >= reach)
+			break;
+	}
+
+	int count = min(k, (int)ranked.size());
+	std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end());
+	for (int i = 0; i < count; i++)
+		out.push_back(items[ranked[i].second].entity);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "common.hpp"
+#include "tiny_ecs.hpp"
+#include "spatial_hash.hpp"
+
+// stlib
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Entities registered with an axis aligned box and a center, answers nearest neighbour queries
+// through a SpatialHash. The physics system rebuilds pinball_query every step, the results are as
+// fresh as the last physics step so the caller checks that an entity still has the components it
+// needs.
+class SpatialQuery
+{
+public:
+	// Entities the query may return, all of them if empty
+	typedef std::function<bool(Entity)> Filter;
+
+	explicit SpatialQuery(float cell_size = 64.f) : grid(cell_size) {}
+
+	void clear();
+	void insert(Entity entity, vec2 lo, vec2 hi, vec2 center);
+
+	// Up to k entities closest to pos by their centers, nearest first
+	void nearest(vec2 pos, int k, std::vector<Entity>& out, const Filter& accept = Filter());
+
+	size_t size() const { return items.size(); }
+
+private:
+	struct Item
+	{
+		Entity entity;
+		vec2 lo, hi;
+		vec2 center;
+	};
+
+	SpatialHash grid;
+	std::vector<Item> items; // indexed by the ids in the grid
+	vec2 bounds_lo, bounds_hi; // of all boxes, ends the nearest search
+
+	// scratch
+	std::vector<unsigned int> candidates;
+	std::vector<std::pair<float, unsigned int>> ranked;
+
+	bool accepted(const Item& item, const Filter& accept) const { return !accept || accept(item.entity); }
+};
+
+// Pinball bodies by their vertices, rebuilt by PhysicsSystem::step
+extern SpatialQuery pinball_query;
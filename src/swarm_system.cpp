@@ -58,6 +58,14 @@ void SwarmSystem::spawn_swarm(vec2 boundary) {
 }
 
 void SwarmSystem::handle_swarm_collision() {
+    // where the main balls are drawn this frame, the pinball_query boxes are a physics step behind
+    main_balls.clear();
+    for (int i = 0; i < registry.balls.components.size(); i++) {
+        if (registry.balls.components[i].isMainBall) {
+            main_balls.push_back(registry.motions.get(registry.balls.entities[i]).position);
+        }
+    }
+
     for (Entity b: registry.swarmEnemies.entities) {
         if (collides(b)) {
             handle_collision(b);
@@ -66,20 +74,14 @@ void SwarmSystem::handle_swarm_collision() {
 }
 
 bool SwarmSystem::collides(Entity b_j) {
-    Entity mainBall;
-    for (int i = 0; i < registry.balls.components.size(); i++) {
-        if (registry.balls.components[i].isMainBall) {
-            mainBall = registry.balls.entities[i];
-        }
-    }
-
-    Motion &ball_motion = registry.motions.get(mainBall);
     Motion &boid_motion = registry.motions.get(b_j);
 
-    vec2 diff = ball_motion.position - boid_motion.position;
-    float dist = diff.x * diff.x + diff.y * diff.y;
-    if (dist < 2000) {
-        return true;
+    for (vec2 ball_position : main_balls) {
+        vec2 diff = ball_position - boid_motion.position;
+        float dist = diff.x * diff.x + diff.y * diff.y;
+        if (dist < 2000) {
+            return true;
+        }
     }
 
     return false;
@@ -35,6 +35,9 @@ private:
 
     bool collides(Entity b_j);
 
+    // positions of the main balls for this frame's collides checks
+    std::vector<vec2> main_balls;
+
     void handle_collision(Entity b_j);
 
     // some of these numbers are inverted because of scuffed programing
@@ -0,0 +1,171 @@
+// internal
+#include "tile_map.hpp"
+
+// stlib
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+TileMap room_tiles;
+
+// Boxes are shrunk by this much before looking up their cells, a box resting against a cell border
+// does not overlap the cell behind it
+static const float EDGE = 1e-3f;
+
+void TileMap::reset(vec2 size)
+{
+	columns = (int)std::ceil(size.x / cell_size);
+	rows = (int)std::ceil(size.y / cell_size);
+	words = (columns + 63) / 64;
+	flags.assign(columns * rows, 0);
+	walls.assign(words * rows, 0);
+}
+
+int TileMap::cell_of(float coordinate) const
+{
+	return (int)std::floor(coordinate / cell_size);
+}
+
+void TileMap::mark(vec2 lo, vec2 hi, uint8_t tile_flags)
+{
+	int x0 = std::max(cell_of(lo.x + EDGE), 0);
+	int x1 = std::min(cell_of(hi.x - EDGE), columns - 1);
+	int y0 = std::max(cell_of(lo.y + EDGE), 0);
+	int y1 = std::min(cell_of(hi.y - EDGE), rows - 1);
+	for (int cy = y0; cy <= y1; cy++)
+	{
+		for (int cx = x0; cx <= x1; cx++)
+		{
+			flags[cy * columns + cx] |= tile_flags;
+			if (tile_flags & TILE_WALL)
+				walls[cy * words + (cx >> 6)] |= 1ull << (cx & 63);
+		}
+	}
+}
+
+uint8_t TileMap::at(vec2 pos) const
+{
+	int cx = cell_of(pos.x);
+	int cy = cell_of(pos.y);
+	if (cx < 0 || cy < 0 || cx >= columns || cy >= rows)
+		return 0;
+	return flags[cy * columns + cx];
+}
+
+uint8_t TileMap::flags_in(vec2 lo, vec2 hi) const
+{
+	int x0 = std::max(cell_of(lo.x + EDGE), 0);
+	int x1 = std::min(cell_of(hi.x - EDGE), columns - 1);
+	int y0 = std::max(cell_of(lo.y + EDGE), 0);
+	int y1 = std::min(cell_of(hi.y - EDGE), rows - 1);
+	uint8_t found = 0;
+	for (int cy = y0; cy <= y1; cy++)
+		for (int cx = x0; cx <= x1; cx++)
+			found |= flags[cy * columns + cx];
+	return found;
+}
+
+bool TileMap::wall(int cx, int cy) const
+{
+	if (cx < 0 || cy < 0 || cx >= columns || cy >= rows)
+		return false;
+	return (walls[cy * words + (cx >> 6)] >> (cx & 63)) & 1;
+}
+
+bool TileMap::any_wall(int x0, int x1, int y0, int y1) const
+{
+	x0 = std::max(x0, 0);
+	x1 = std::min(x1, columns - 1);
+	y0 = std::max(y0, 0);
+	y1 = std::min(y1, rows - 1);
+	if (x0 > x1)
+		return false;
+
+	// whole words of the row at a time, masked to [x0, x1] at both ends
+	for (int cy = y0; cy <= y1; cy++)
+	{
+		const uint64_t* row = &walls[cy * words];
+		for (int w = x0 >> 6; w <= x1 >> 6; w++)
+		{
+			uint64_t mask = ~0ull;
+			if (w == x0 >> 6)
+				mask &= ~0ull << (x0 & 63);
+			if (w == x1 >> 6)
+				mask &= ~0ull >> (63 - (x1 & 63));
+			if (row[w] & mask)
+				return true;
+		}
+	}
+	return false;
+}
+
+vec2 TileMap::sweep(vec2 from, vec2 to, vec2 half, vec2& velocity) const
+{
+	// stuck in a wall, e.g. spawned there, let it walk out
+	if (any_wall(cell_of(from.x - half.x + EDGE), cell_of(from.x + half.x - EDGE), cell_of(from.y - half.y + EDGE), cell_of(from.y + half.y - EDGE)))
+		return to;
+
+	vec2 pos = from;
+	for (int axis = 0; axis < 2; axis++)
+	{
+		int other = 1 - axis;
+		int across_lo = cell_of(pos[other] - half[other] + EDGE);
+		int across_hi = cell_of(pos[other] + half[other] - EDGE);
+
+		// step the leading side of the box one line of cells at a time up to where it ends up
+		int dir = to[axis] > pos[axis] ? 1 : -1;
+		int line = cell_of(pos[axis] + dir * (half[axis] - EDGE));
+		int last = cell_of(to[axis] + dir * (half[axis] - EDGE));
+		while (line != last)
+		{
+			line += dir;
+			bool blocked = axis == 0 ? any_wall(line, line, across_lo, across_hi) : any_wall(across_lo, across_hi, line, line);
+			if (blocked)
+			{
+				// rest against the near border of the wall
+				float border = (dir > 0 ? line : line + 1) * cell_size;
+				to[axis] = border - dir * half[axis];
+				velocity[axis] = 0.f;
+				break;
+			}
+		}
+		pos[axis] = to[axis];
+	}
+	return pos;
+}
+
+bool TileMap::line_blocked(vec2 from, vec2 to) const
+{
+	// Walk the cells along the segment (Amanatides & Woo)
+	vec2 d = to - from;
+	int cx = cell_of(from.x);
+	int cy = cell_of(from.y);
+	int end_x = cell_of(to.x);
+	int end_y = cell_of(to.y);
+	int step_x = d.x > 0.f ? 1 : -1;
+	int step_y = d.y > 0.f ? 1 : -1;
+
+	float next_x = d.x != 0.f ? ((cx + (step_x > 0 ? 1 : 0)) * cell_size - from.x) / d.x : FLT_MAX;
+	float next_y = d.y != 0.f ? ((cy + (step_y > 0 ? 1 : 0)) * cell_size - from.y) / d.y : FLT_MAX;
+	float delta_x = d.x != 0.f ? cell_size / std::abs(d.x) : FLT_MAX;
+	float delta_y = d.y != 0.f ? cell_size / std::abs(d.y) : FLT_MAX;
+
+	for (;;)
+	{
+		if (wall(cx, cy))
+			return true;
+		if ((cx == end_x && cy == end_y) || std::min(next_x, next_y) > 1.f)
+			return false;
+
+		if (next_x < next_y)
+		{
+			cx += step_x;
+			next_x += delta_x;
+		}
+		else
+		{
+			cy += step_y;
+			next_y += delta_y;
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "common.hpp"
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+// What a room tile holds, a cell can hold several
+enum TILE_FLAG : uint8_t {
+	TILE_WALL = 1u << 0,
+	TILE_SPIKES = 1u << 1,
+	TILE_DOOR = 1u << 2,
+};
+
+// Static room geometry baked into a grid of cells over [0, size], a bit per cell for the walls and a
+// byte of TILE_FLAGs per cell. createBar, createSpikes and createDoor mark their own cells, the walls,
+// spikes and doors take no part in the world mode collision check. Everything outside the grid is empty.
+class TileMap
+{
+public:
+	explicit TileMap(float cell_size = 10.f) : cell_size(cell_size) {}
+
+	// Empty map covering [0, size]
+	void reset(vec2 size);
+
+	// Adds flags to every cell overlapping the box [lo, hi]
+	void mark(vec2 lo, vec2 hi, uint8_t flags);
+
+	// Flags of the cell containing pos
+	uint8_t at(vec2 pos) const;
+
+	// Flags of all cells overlapping the box [lo, hi], or'ed together
+	uint8_t flags_in(vec2 lo, vec2 hi) const;
+
+	// Moves a box of half size half from `from` towards `to`, x first and then y, a cell at a time.
+	// Stops in front of the first wall on each axis and zeroes that axis of velocity. A box that
+	// starts out overlapping a wall is not stopped, so it can walk out.
+	vec2 sweep(vec2 from, vec2 to, vec2 half, vec2& velocity) const;
+
+	// Whether the segment from -> to crosses a wall cell
+	bool line_blocked(vec2 from, vec2 to) const;
+
+	float cell() const { return cell_size; }
+
+private:
+	float cell_size;
+	int columns = 0;
+	int rows = 0;
+	int words = 0; // 64 bit words per row of walls
+	std::vector<uint8_t> flags; // TILE_FLAGs, row major
+	std::vector<uint64_t> walls; // a bit per cell, rows of words
+
+	int cell_of(float coordinate) const;
+	bool wall(int cx, int cy) const;
+	// Any wall in the cells [x0, x1] x [y0, y1], clipped to the grid
+	bool any_wall(int x0, int x1, int y0, int y1) const;
+};
+
+// The current world mode room, reset by WorldSystem::bake_room_tiles when the room is cleared
+extern TileMap room_tiles;
@@ -2,4 +2,26 @@
 #include "tiny_ecs.hpp"
 
 // All we need to store besides the containers is the id of every entity and callbacks to be able to remove entities across containers
-unsigned int Entity::id_count = 1;
\ No newline at end of file
+unsigned int Entity::id_count = 1;
+std::vector<unsigned int> Entity::free_list;
+std::vector<unsigned int> Entity::generations(1, 0); // slot 0 is never handed out
+
+void Entity::serialize_ids(std::vector<char>& out)
+{
+	unsigned int sizes[2] = { (unsigned int)free_list.size(), (unsigned int)generations.size() };
+	snapshot_write(out, &id_count, sizeof(id_count));
+	snapshot_write(out, sizes, sizeof(sizes));
+	snapshot_write(out, free_list.data(), free_list.size() * sizeof(unsigned int));
+	snapshot_write(out, generations.data(), generations.size() * sizeof(unsigned int));
+}
+
+void Entity::deserialize_ids(SnapshotReader& in)
+{
+	unsigned int sizes[2];
+	in.read(&id_count, sizeof(id_count));
+	in.read(sizes, sizeof(sizes));
+	free_list.resize(sizes[0]);
+	generations.resize(sizes[1]);
+	in.read(free_list.data(), free_list.size() * sizeof(unsigned int));
+	in.read(generations.data(), generations.size() * sizeof(unsigned int));
+}
@@ -2,43 +2,350 @@
 
 #include <algorithm>
 #include <vector>
-#include <unordered_map>
 #include <set>
 #include <functional>
+#include <tuple>
 #include <typeindex>
+#include <type_traits>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <typeinfo>
 #include <assert.h>
 
+// Helpers to write registry snapshots into a byte buffer and read them back.
+// Bulk copied arrays start at 16 byte aligned offsets so they can be read in place.
+enum : size_t { SNAPSHOT_ALIGNMENT = 16 };
+
+inline void snapshot_write(std::vector<char>& out, const void* data, size_t size)
+{
+	const char* bytes = static_cast<const char*>(data);
+	out.insert(out.end(), bytes, bytes + size);
+}
+
+inline void snapshot_align(std::vector<char>& out)
+{
+	out.resize((out.size() + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1));
+}
+
+struct SnapshotReader
+{
+	const char* begin;
+	const char* cursor;
+
+	void read(void* data, size_t size)
+	{
+		memcpy(data, cursor, size);
+		cursor += size;
+	}
+
+	void align()
+	{
+		size_t offset = cursor - begin;
+		cursor = begin + ((offset + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1));
+	}
+};
+
+// Components that are trivially copyable are snapshotted with a single memcpy of the dense array.
+// Specialize to false for types that need serialize_component/deserialize_component overloads,
+// e.g. pointers to assets that have to be stored as asset ids.
+template <typename Component>
+struct snapshot_bulk_copy : std::is_trivially_copyable<Component> {};
+
 // Unique identifyer for all entities
+// The handle packs a slot index (low bits) and the generation of that slot (high bits). Slots of
+// released entities are recycled, the bumped generation makes old handles to that slot stale.
+// A default constructed handle is the null entity (slot 0), only Entity::create() takes a slot.
 class Entity
 {
-	unsigned int id;
+	unsigned int id = 0;
 	static unsigned int id_count; // starts from 1, entit 0 is the default initialization
+	static std::vector<unsigned int> free_list; // released slots waiting for re-use
+	static std::vector<unsigned int> generations; // current generation of every slot
 public:
-	Entity()
+	enum : unsigned int { INDEX_BITS = 20, INDEX_MASK = (1u << INDEX_BITS) - 1, GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1 };
+
+	Entity() {}
+
+	// A new entity in a free slot. Not thread safe, entities are created on the main thread only.
+	static Entity create()
 	{
-		id = id_count++;
-		// Note, indices of already deleted entities arent re-used in this simple implementation.
+		unsigned int index;
+		if (!free_list.empty())
+		{
+			index = free_list.back();
+			free_list.pop_back();
+		}
+		else
+		{
+			index = id_count++;
+			if (index > INDEX_MASK)
+			{
+				// a handle of a slot past the mask would alias slot 0 and on, there is no way to go on
+				fprintf(stderr, "Ran out of entity slots (%u)\n", INDEX_MASK);
+				abort();
+			}
+			generations.push_back(0);
+		}
+		Entity e;
+		e.id = (generations[index] << INDEX_BITS) | index;
+		return e;
 	}
 	operator unsigned int() { return id; } // this enables automatic casting to int
+
+	// Slot of the entity, used to index sparse arrays
+	unsigned int index() const { return id & INDEX_MASK; }
+	unsigned int generation() const { return id >> INDEX_BITS; }
+
+	// False once the entity was released, even if its slot was re-used in the meantime
+	bool alive() const
+	{
+		return index() != 0 && index() < id_count && generations[index()] == generation();
+	}
+
+	// Save and restore the id allocator along with registry snapshots
+	static void serialize_ids(std::vector<char>& out);
+	static void deserialize_ids(SnapshotReader& in);
+
+	// Retire the slot of e so that a later Entity::create() can re-use it
+	static void release(Entity e)
+	{
+		assert(e.alive() && "Releasing a stale entity");
+		generations[e.index()] = (generations[e.index()] + 1) & GENERATION_MASK;
+		free_list.push_back(e.index());
+	}
 };
 
-// Common interface to refer to all containers in the ECS registry
-struct ContainerInterface
+// Cached, densely packed list of the entities whose signature has all include bits and none of the
+// exclude bits. EntitySignatures keeps it up to date on every insert/remove, so nothing is filtered per frame.
+// Entries are in no particular order, the list must not be structurally changed while iterating it.
+class Query
 {
-	virtual void clear() = 0;
-	virtual size_t size() = 0;
-	virtual void remove(Entity e) = 0;
-	virtual bool has(Entity entity) = 0;
+	enum : unsigned int { TOMBSTONE = 0xFFFFFFFFu };
+	std::vector<unsigned int> positions; // entity slot -> index into entities
+
+	void add(Entity e)
+	{
+		if (e.index() >= positions.size())
+			positions.resize(e.index() + 1, TOMBSTONE);
+		positions[e.index()] = (unsigned int)entities.size();
+		entities.push_back(e);
+	}
+
+	void remove(Entity e)
+	{
+		unsigned int pos = positions[e.index()];
+		entities[pos] = entities.back();
+		positions[entities[pos].index()] = pos;
+		positions[e.index()] = TOMBSTONE;
+		entities.pop_back();
+	}
+
+public:
+	typedef unsigned long long Mask;
+	const Mask include;
+	const Mask exclude;
+
+	// The matching entities
+	std::vector<Entity> entities;
+
+	// Entries changed one at a time vs. visited by full rescans, since the last reset_stats()
+	unsigned int incremental = 0;
+	unsigned int rescanned = 0;
+
+	Query(Mask include, Mask exclude) : include(include), exclude(exclude) {}
+
+	bool matches(Mask mask) const
+	{
+		return (mask & include) == include && !(mask & exclude);
+	}
+
+	// Called with the signature of an entity before and after one of its components was added or removed
+	void update(Entity e, Mask before, Mask after)
+	{
+		bool was = matches(before);
+		bool is = matches(after);
+		if (was == is)
+			return;
+		if (is)
+			add(e);
+		else
+			remove(e);
+		incremental++;
+	}
+
+	// Rebuild the list from the signatures of all slots, owners holds the current handle of each slot
+	void rescan(const std::vector<Mask>& masks, const std::vector<Entity>& owners)
+	{
+		std::fill(positions.begin(), positions.end(), (unsigned int)TOMBSTONE);
+		entities.clear();
+		for (size_t i = 0; i < masks.size(); i++)
+			if (masks[i] && matches(masks[i]))
+				add(owners[i]);
+		rescanned += (unsigned int)masks.size();
+	}
+
+	void reset_stats()
+	{
+		incremental = 0;
+		rescanned = 0;
+	}
+
+	size_t size() const { return entities.size(); }
+	std::vector<Entity>::const_iterator begin() const { return entities.begin(); }
+	std::vector<Entity>::const_iterator end() const { return entities.end(); }
+};
+
+// Per-entity bitmask of the containers that hold a component of it, one bit per registered container
+class EntitySignatures
+{
+	std::vector<unsigned long long> masks; // indexed by entity slot
+	std::vector<Entity> owners; // handle that last changed the mask of each slot
+	std::vector<Query*> queries; // cached queries to update on every change
+	bool notify = true;
+
+	void changed(Entity e, unsigned long long before)
+	{
+		if (notify && before != masks[e.index()])
+			for (Query* query : queries)
+				query->update(e, before, masks[e.index()]);
+	}
+
+public:
+	typedef unsigned long long Mask;
+	static constexpr unsigned int MAX_CONTAINERS = 64;
+
+	void set(Entity e, unsigned int bit)
+	{
+		if (e.index() >= masks.size())
+		{
+			masks.resize(e.index() + 1, 0);
+			owners.resize(e.index() + 1, e);
+		}
+		Mask before = masks[e.index()];
+		masks[e.index()] |= Mask(1) << bit;
+		owners[e.index()] = e;
+		changed(e, before);
+	}
+
+	void reset(Entity e, unsigned int bit)
+	{
+		if (e.index() < masks.size())
+		{
+			Mask before = masks[e.index()];
+			masks[e.index()] &= ~(Mask(1) << bit);
+			changed(e, before);
+		}
+	}
+
+	// Note, this is the mask of the slot, a stale handle gets the one of the entity re-using it
+	Mask of(Entity e) const
+	{
+		return e.index() < masks.size() ? masks[e.index()] : 0;
+	}
+
+	// Keep query up to date from now on, starting with a full rescan
+	void watch(Query* query)
+	{
+		queries.push_back(query);
+		query->rescan(masks, owners);
+	}
+
+	// Stop updating queries one change at a time, e.g. while restoring a snapshot
+	void suspend_queries()
+	{
+		notify = false;
+	}
+
+	// Catch the queries up with a full rescan
+	void resume_queries()
+	{
+		notify = true;
+		for (Query* query : queries)
+			query->rescan(masks, owners);
+	}
+};
+
+// Signature bookkeeping shared by all containers in the ECS registry. The registry knows the concrete
+// container types, so there are no virtual functions, see Registry below.
+struct ContainerBase
+{
+	// Position of the container in the registry, also its bit in the entity signatures
+	unsigned int bit() const { return signature_bit; }
+
+	// Let the container keep the signature bit of its entities up to date
+	void attach(EntitySignatures* signatures, unsigned int bit)
+	{
+		assert(bit < EntitySignatures::MAX_CONTAINERS && "Too many containers for the signature mask");
+		this->signatures = signatures;
+		signature_bit = bit;
+	}
+
+protected:
+	EntitySignatures* signatures = nullptr;
+	unsigned int signature_bit = 0;
 };
 
 // A container that stores components of type 'Component' and associated entities
 template <typename Component> // A component can be any class
-class ComponentContainer : public ContainerInterface
+class ComponentContainer : public ContainerBase
 {
 private:
-	// The hash map from Entity -> array index.
-	std::unordered_map<unsigned int, unsigned int> map_entity_componentID; // the entity is cast to uint to be hashable.
+	// The sparse set from Entity -> array index. Entity slots index into fixed size pages that are only
+	// allocated once an entity of that range gets a component, unused slots hold TOMBSTONE.
+	enum : unsigned int { PAGE_BITS = 10, PAGE_SIZE = 1u << PAGE_BITS, TOMBSTONE = 0xFFFFFFFFu };
+	std::vector<std::vector<unsigned int>> sparse_pages;
 	bool registered = false;
+
+	// Slot of the sparse set for entity id, or nullptr if its page was never allocated
+	unsigned int* sparse_slot(unsigned int id)
+	{
+		unsigned int page = id >> PAGE_BITS;
+		if (page >= sparse_pages.size() || sparse_pages[page].empty())
+			return nullptr;
+		return &sparse_pages[page][id & (PAGE_SIZE - 1)];
+	}
+
+	void serialize_components(std::vector<char>& out, std::true_type)
+	{
+		snapshot_align(out);
+		snapshot_write(out, components.data(), components.size() * sizeof(Component));
+	}
+
+	void serialize_components(std::vector<char>& out, std::false_type)
+	{
+		for (const Component& c : components)
+			serialize_component(out, c);
+	}
+
+	void deserialize_components(SnapshotReader& in, unsigned int count, std::true_type)
+	{
+		in.align();
+		const Component* restored = reinterpret_cast<const Component*>(in.cursor);
+		components.assign(restored, restored + count);
+		in.cursor += count * sizeof(Component);
+	}
+
+	void deserialize_components(SnapshotReader& in, unsigned int count, std::false_type)
+	{
+		components.resize(count);
+		for (Component& c : components)
+			deserialize_component(in, c);
+	}
+
+	// Same as above, but allocates the page if needed
+	unsigned int& sparse_slot_assure(unsigned int id)
+	{
+		unsigned int page = id >> PAGE_BITS;
+		if (page >= sparse_pages.size())
+			sparse_pages.resize(page + 1);
+		if (sparse_pages[page].empty())
+			sparse_pages[page].assign(PAGE_SIZE, TOMBSTONE);
+		return sparse_pages[page][id & (PAGE_SIZE - 1)];
+	}
+
 public:
 	// Container of all components of type 'Component'
 	std::vector<Component> components;
@@ -54,15 +361,15 @@ public:
 	// Inserting a component c associated to entity e
 	inline Component& insert(Entity e, Component c, bool check_for_duplicates = true)
 	{	
-		if (check_for_duplicates && has(e)) {
-			int a = 1;
-		}
 		// Usually, every entity should only have one instance of each component type
 		assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
 
-		map_entity_componentID[e] = (unsigned int)components.size();
+		// with duplicates, the slot points to the most recently inserted component
+		sparse_slot_assure(e.index()) = (unsigned int)components.size();
 		components.push_back(std::move(c)); // the move enforces move instead of copy constructor
 		entities.push_back(e);
+		if (signatures)
+			signatures->set(e, signature_bit);
 		return components.back();
 	};
 
@@ -78,16 +385,15 @@ public:
 
 	// A wrapper to return the component of an entity
 	Component& get(Entity e) {
-        if (!has(e)) {
-			int a = 0;
-        }
 		assert(has(e) && "Entity not contained in ECS registry");
-		return components[map_entity_componentID[e]];
+		return components[*sparse_slot(e.index())];
 	}
 
 	// Check if entity has a component of type 'Component'
 	bool has(Entity entity) {
-		return map_entity_componentID.count(entity) > 0;
+		// the slot may belong to a newer entity re-using the index, compare the full handle
+		unsigned int* slot = sparse_slot(entity.index());
+		return slot && *slot != TOMBSTONE && (unsigned int)entities[*slot] == (unsigned int)entity;
 	}
 
 	// Remove an component and pack the container to re-use the empty space
@@ -96,26 +402,37 @@ public:
 		if (has(e))
 		{
 			// Get the current position
-			int cID = map_entity_componentID[e];
+			unsigned int* slot = sparse_slot(e.index());
+			unsigned int cID = *slot;
 
 			// Move the last element to position cID using the move operator
 			// Note, components[cID] = components.back() would trigger the copy instead of move operator
 			components[cID] = std::move(components.back());
 			entities[cID] = entities.back(); // the entity is only a single index, copy it.
-			map_entity_componentID[entities.back()] = cID;
+			// only re-point the slot if it referred to the moved element, it might belong to a newer entity
+			unsigned int* moved = sparse_slot(entities.back().index());
+			if (*moved == components.size() - 1)
+				*moved = cID;
 
 			// Erase the old component and free its memory
-			map_entity_componentID.erase(e);
+			*slot = TOMBSTONE;
 			components.pop_back();
 			entities.pop_back();
-			// Note, one could mark the id for re-use
+			if (signatures)
+				signatures->reset(e, signature_bit);
 		}
 	};
 
 	// Remove all components of type 'Component'
 	void clear()
 	{
-		map_entity_componentID.clear();
+		// only reset the slots in use, the pages themselves are kept for re-use
+		for (Entity e : entities)
+		{
+			*sparse_slot(e.index()) = TOMBSTONE;
+			if (signatures)
+				signatures->reset(e, signature_bit);
+		}
 		components.clear();
 		entities.clear();
 	}
@@ -126,6 +443,36 @@ public:
 		return components.size();
 	}
 
+	// Append entities and components to a snapshot buffer
+	void serialize(std::vector<char>& out)
+	{
+		unsigned int count = (unsigned int)components.size();
+		snapshot_write(out, &count, sizeof(count));
+		snapshot_align(out);
+		snapshot_write(out, entities.data(), count * sizeof(Entity));
+		serialize_components(out, snapshot_bulk_copy<Component>());
+	}
+
+	// Replace the content of the container with the next section of a snapshot
+	void deserialize(SnapshotReader& in)
+	{
+		clear();
+		unsigned int count;
+		in.read(&count, sizeof(count));
+		in.align();
+		const Entity* restored = reinterpret_cast<const Entity*>(in.cursor);
+		entities.assign(restored, restored + count);
+		in.cursor += count * sizeof(Entity);
+		deserialize_components(in, count, snapshot_bulk_copy<Component>());
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			sparse_slot_assure(entities[i].index()) = i;
+			if (signatures)
+				signatures->set(entities[i], signature_bit);
+		}
+	}
+
 	// Sort the components and associated entity assignment structures by the comparisonFunction, see std::sort
 	template <class Compare>
 	void sort(Compare comparisonFunction)
@@ -134,10 +481,499 @@ public:
 		std::sort(entities.begin(), entities.end(), comparisonFunction);
 		// Now re-arrange the components (Note, creates a new vector, which may be slow! Not sure if in-place could be faster: https://stackoverflow.com/questions/63703637/how-to-efficiently-permute-an-array-in-place-using-stdswap)
 		std::vector<Component> components_new; components_new.reserve(components.size());
-		std::transform(entities.begin(), entities.end(), std::back_inserter(components_new), [&](Entity e) { return std::move(get(e)); }); // note, the get still uses the old hash map (on purpose!)
+		std::transform(entities.begin(), entities.end(), std::back_inserter(components_new), [&](Entity e) { return std::move(get(e)); }); // note, the get still uses the old sparse set (on purpose!)
 		components = std::move(components_new); // note, we use move operations to not create unneccesary copies of objects, but memory is still allocated for the new vector
-		// Fill the new hashmap
+		// Fill the new sparse set
 		for (unsigned int i = 0; i < entities.size(); i++)
-			map_entity_componentID[entities[i]] = i;
+			*sparse_slot(entities[i].index()) = i;
+	}
+};
+
+// A container for empty tag components, e.g. Zombie or Combat. Instead of the sparse set and a component
+// array it keeps one bit per entity slot plus the entity list, so has() is a bit test in the common case.
+// Same API as ComponentContainer, get() hands out a shared instance as tags have no data.
+template <typename Component>
+class TagContainer : public ContainerBase
+{
+private:
+	static_assert(std::is_empty<Component>::value, "Only empty structs can be stored as tags");
+	std::vector<unsigned long long> bits; // one bit per entity slot
+	std::vector<unsigned int> positions; // entity slot -> index into entities, only valid if the bit is set
+
+	bool test(unsigned int id) const
+	{
+		return (id >> 6) < bits.size() && ((bits[id >> 6] >> (id & 63)) & 1);
+	}
+
+public:
+	// The tagged entities
+	std::vector<Entity> entities;
+
+	inline Component& insert(Entity e, Component c = {}, bool check_for_duplicates = true)
+	{
+		assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
+		(void)c;
+		if (has(e))
+			return get(e);
+
+		unsigned int id = e.index();
+		if ((id >> 6) >= bits.size())
+			bits.resize((id >> 6) + 1, 0);
+		if (id >= positions.size())
+			positions.resize(id + 1);
+		bits[id >> 6] |= 1ull << (id & 63);
+		positions[id] = (unsigned int)entities.size();
+		entities.push_back(e);
+		if (signatures)
+			signatures->set(e, signature_bit);
+		return get(e);
+	}
+
+	template<typename... Args>
+	Component& emplace(Entity e, Args &&... args) {
+		return insert(e, Component(std::forward<Args>(args)...));
+	};
+	template<typename... Args>
+	Component& emplace_with_duplicates(Entity e, Args &&... args) {
+		return insert(e, Component(std::forward<Args>(args)...), false);
+	};
+
+	Component& get(Entity e) {
+		assert(has(e) && "Entity not contained in ECS registry");
+		(void)e;
+		static Component tag;
+		return tag;
+	}
+
+	bool has(Entity entity) {
+		// the bit may belong to a newer entity re-using the slot, compare the full handle
+		return test(entity.index()) && (unsigned int)entities[positions[entity.index()]] == (unsigned int)entity;
+	}
+
+	void remove(Entity e)
+	{
+		if (has(e))
+		{
+			unsigned int id = e.index();
+			unsigned int cID = positions[id];
+			entities[cID] = entities.back();
+			positions[entities[cID].index()] = cID;
+			entities.pop_back();
+			bits[id >> 6] &= ~(1ull << (id & 63));
+			if (signatures)
+				signatures->reset(e, signature_bit);
+		}
+	}
+
+	void clear()
+	{
+		for (Entity e : entities)
+		{
+			bits[e.index() >> 6] &= ~(1ull << (e.index() & 63));
+			if (signatures)
+				signatures->reset(e, signature_bit);
+		}
+		entities.clear();
+	}
+
+	size_t size()
+	{
+		return entities.size();
+	}
+
+	// Tags have no data, only the entities are written
+	void serialize(std::vector<char>& out)
+	{
+		unsigned int count = (unsigned int)entities.size();
+		snapshot_write(out, &count, sizeof(count));
+		snapshot_align(out);
+		snapshot_write(out, entities.data(), count * sizeof(Entity));
+	}
+
+	void deserialize(SnapshotReader& in)
+	{
+		clear();
+		unsigned int count;
+		in.read(&count, sizeof(count));
+		in.align();
+		const Entity* restored = reinterpret_cast<const Entity*>(in.cursor);
+		in.cursor += count * sizeof(Entity);
+		for (unsigned int i = 0; i < count; i++)
+			insert(restored[i]);
+	}
+};
+
+// Storage used by the registry for a component type, empty structs are stored as tags
+template <typename Component>
+using storage_t = typename std::conditional<std::is_empty<Component>::value, TagContainer<Component>, ComponentContainer<Component>>::type;
+
+// Component types that entities of a view must not have, e.g. registry.view<Motion>(exclude<Combat>)
+template <typename... Component>
+struct exclude_t {};
+template <typename... Component>
+constexpr exclude_t<Component...> exclude{};
+
+// Iterates all entities that have every Include component and none of the Exclude components.
+// Iteration is driven by the smallest Include container and probes the others, nothing is allocated.
+// Entities are visited back to front, so removing the current entity while iterating is fine.
+template <typename Includes, typename Excludes>
+class View;
+
+template <typename... Include, typename... Exclude>
+class View<std::tuple<Include...>, std::tuple<Exclude...>>
+{
+	std::tuple<storage_t<Include>*...> includes;
+	std::tuple<storage_t<Exclude>*...> excludes;
+	std::vector<Entity>* driver = nullptr;
+
+	template <typename Container>
+	void pick_driver(Container* container)
+	{
+		if (!driver || container->entities.size() < driver->size())
+			driver = &container->entities;
+	}
+
+public:
+	View(storage_t<Include>&... include, storage_t<Exclude>&... exclude)
+		: includes(&include...), excludes(&exclude...)
+	{
+		static_assert(sizeof...(Include) > 0, "A view needs at least one component to iterate");
+		int expand[] = { 0, (pick_driver(&include), 0)... };
+		(void)expand;
+	}
+
+	// Check if entity is part of this view
+	bool contains(Entity e) const
+	{
+		bool match = true;
+		int expand_include[] = { 0, (match = match && std::get<storage_t<Include>*>(includes)->has(e), 0)... };
+		int expand_exclude[] = { 0, (match = match && !std::get<storage_t<Exclude>*>(excludes)->has(e), 0)... };
+		(void)expand_include; (void)expand_exclude;
+		return match;
+	}
+
+	// A wrapper to return one of the included components of an entity in the view
+	template <typename Component>
+	Component& get(Entity e) const
+	{
+		return std::get<storage_t<Component>*>(includes)->get(e);
+	}
+
+	// Calls func(Entity, Include&...) for every entity in the view
+	template <typename Func>
+	void each(Func func) const
+	{
+		for (size_t i = driver->size(); i-- > 0;)
+		{
+			// the driver may shrink by more than one entity while iterating
+			if (i >= driver->size())
+				continue;
+			Entity e = (*driver)[i];
+			if (contains(e))
+				func(e, std::get<storage_t<Include>*>(includes)->get(e)...);
+		}
+	}
+
+	class iterator
+	{
+		const View* view;
+		size_t i;
+
+		void skip()
+		{
+			while (i > 0 && (i > view->driver->size() || !view->contains((*view->driver)[i - 1])))
+				--i;
+		}
+
+	public:
+		iterator(const View* view, size_t i) : view(view), i(i) { skip(); }
+		Entity operator*() const { return (*view->driver)[i - 1]; }
+		iterator& operator++() { --i; skip(); return *this; }
+		bool operator!=(const iterator& other) const { return i != other.i; }
+	};
+
+	iterator begin() const { return iterator(this, driver->size()); }
+	iterator end() const { return iterator(this, 0); }
+
+	// Upper bound of the number of entities visited
+	size_t size_hint() const { return driver->size(); }
+};
+
+// Position of T in the type list Ts..., a compile error if T is not part of it
+template <typename T, typename... Ts>
+struct type_index;
+template <typename T, typename... Ts>
+struct type_index<T, T, Ts...> : std::integral_constant<unsigned int, 0> {};
+template <typename T, typename U, typename... Ts>
+struct type_index<T, U, Ts...> : std::integral_constant<unsigned int, 1 + type_index<T, Ts...>::value> {};
+
+// Owns one container per component type, e.g. Registry<Motion, RenderRequest, ...>. The position of a type
+// in the list is its container index and signature bit. Operations over all containers are expanded at
+// compile time, the ones that only touch the containers of an entity go through a table of functions.
+template <typename... Components>
+class RegistryCommands;
+
+template <typename... Components>
+class Registry
+{
+	std::tuple<storage_t<Components>...> containers;
+
+	// Which of the containers hold each entity
+	EntitySignatures signatures;
+
+	// Size of the last snapshot, to allocate the next one at once
+	size_t snapshot_capacity = 0;
+
+	// Cached queries handed out by query<...>(), they live as long as the registry
+	std::vector<std::unique_ptr<Query>> queries;
+
+	typedef void (*EntityFunction)(Registry&, Entity);
+
+	template <typename Component>
+	static void remove_from(Registry& registry, Entity e)
+	{
+		registry.template get<Component>().remove(e);
+	}
+
+public:
+	// Deferred structural changes of this kind of registry
+	typedef RegistryCommands<Components...> Commands;
+
+	static constexpr unsigned int CONTAINER_COUNT = sizeof...(Components);
+	static_assert(CONTAINER_COUNT <= EntitySignatures::MAX_CONTAINERS, "Too many containers for the signature mask");
+
+	// Index of the container of a component type
+	template <typename Component>
+	static constexpr unsigned int index_of()
+	{
+		return type_index<Component, Components...>::value;
+	}
+
+	Registry()
+	{
+		int expand[] = { 0, (get<Components>().attach(&signatures, index_of<Components>()), 0)... };
+		(void)expand;
+	}
+
+	// Containers point back at the signatures, the registry stays in place
+	Registry(const Registry&) = delete;
+	Registry& operator=(const Registry&) = delete;
+
+	// The container of a component type, e.g. get<Motion>()
+	template <typename Component>
+	storage_t<Component>& get()
+	{
+		return std::get<type_index<Component, Components...>::value>(containers);
+	}
+
+	void clear_all_components() {
+		int expand[] = { 0, (get<Components>().clear(), 0)... };
+		(void)expand;
+	}
+
+	void list_all_components() {
+		printf("Debug info on all registry entries:\n");
+		int expand[] = { 0, (get<Components>().size() > 0 ? printf("%4d components of type %s\n", (int)get<Components>().size(), typeid(Components).name()) : 0, 0)... };
+		(void)expand;
+	}
+
+	void list_all_components_of(Entity e) {
+		static const char* const names[] = { typeid(Components).name()... };
+		printf("Debug info on components of entity %u:\n", (unsigned int)e);
+		if (!e.alive())
+			return;
+		EntitySignatures::Mask mask = signatures.of(e);
+		for (unsigned int i = 0; mask; i++, mask >>= 1)
+			if (mask & 1)
+				printf("type %s\n", names[i]);
+	}
+
+	// Removes all components and retires the entity, its handle becomes stale and the slot is re-used.
+	// Stale handles are fine to pass, containers only ever match the exact handle.
+	void remove_all_components_of(Entity e) {
+		static const EntityFunction removers[] = { &Registry::remove_from<Components>... };
+		// only visit the containers that hold the entity, copy the mask as it is cleared while removing
+		EntitySignatures::Mask mask = signatures.of(e);
+		for (unsigned int i = 0; mask; i++, mask >>= 1)
+			if (mask & 1)
+				removers[i](*this, e);
+		if (e.alive())
+			Entity::release(e);
+	}
+
+	// Same as above for a batch of entities, but visits one container at a time
+	void remove_all_components_of(std::vector<Entity>& batch) {
+		static const EntityFunction removers[] = { &Registry::remove_from<Components>... };
+		std::sort(batch.begin(), batch.end(), [](Entity a, Entity b) { return (unsigned int)a < (unsigned int)b; });
+		batch.erase(std::unique(batch.begin(), batch.end(), [](Entity a, Entity b) { return (unsigned int)a == (unsigned int)b; }), batch.end());
+
+		EntitySignatures::Mask owners = 0;
+		for (Entity e : batch)
+			owners |= signatures.of(e);
+		for (unsigned int i = 0; owners; i++, owners >>= 1)
+			if (owners & 1)
+				for (Entity e : batch)
+					if ((signatures.of(e) >> i) & 1)
+						removers[i](*this, e);
+		for (Entity e : batch)
+			if (e.alive())
+				Entity::release(e);
+	}
+
+	// Copy of the complete registry state, including the entity id allocator, for quick-saves and rollback
+	std::vector<char> snapshot() {
+		std::vector<char> out;
+		out.reserve(snapshot_capacity);
+		unsigned int count = CONTAINER_COUNT;
+		snapshot_write(out, &count, sizeof(count));
+		Entity::serialize_ids(out);
+		int expand[] = { 0, (get<Components>().serialize(out), 0)... };
+		(void)expand;
+		snapshot_capacity = out.size();
+		return out;
+	}
+
+	// Replace the registry state with a snapshot, handles held elsewhere are only valid if taken before it
+	void restore(const std::vector<char>& data) {
+		SnapshotReader in{ data.data(), data.data() };
+		unsigned int count;
+		in.read(&count, sizeof(count));
+		assert(count == CONTAINER_COUNT && "Snapshot was taken with a different set of containers");
+		Entity::deserialize_ids(in);
+		signatures.suspend_queries();
+		int expand[] = { 0, (get<Components>().deserialize(in), 0)... };
+		(void)expand;
+		signatures.resume_queries();
+	}
+
+	// Check if e still refers to a live entity, e.g. for handles stored inside other components
+	bool valid(Entity e) const {
+		return e.alive();
+	}
+
+	// Entities that have all of the given components, e.g. view<Motion, RenderRequest>(exclude<Combat>)
+	template <typename... Include, typename... Exclude>
+	View<std::tuple<Include...>, std::tuple<Exclude...>> view(exclude_t<Exclude...> = {}) {
+		return View<std::tuple<Include...>, std::tuple<Exclude...>>(get<Include>()..., get<Exclude>()...);
+	}
+
+	// Same filter as view<...>(), but the entity list is cached and updated on every insert/remove.
+	// Asking again for the same components returns the same query.
+	template <typename... Include, typename... Exclude>
+	Query& query(exclude_t<Exclude...> = {}) {
+		EntitySignatures::Mask include = 0, exclude = 0;
+		int expand_include[] = { 0, (include |= EntitySignatures::Mask(1) << index_of<Include>(), 0)... };
+		int expand_exclude[] = { 0, (exclude |= EntitySignatures::Mask(1) << index_of<Exclude>(), 0)... };
+		(void)expand_include; (void)expand_exclude;
+		for (std::unique_ptr<Query>& cached : queries)
+			if (cached->include == include && cached->exclude == exclude)
+				return *cached;
+		queries.emplace_back(new Query(include, exclude));
+		signatures.watch(queries.back().get());
+		return *queries.back();
+	}
+
+	// All queries created so far, e.g. to show their update counters
+	const std::vector<std::unique_ptr<Query>>& cached_queries() const {
+		return queries;
+	}
+};
+
+// Records structural changes (create/destroy entities, add/remove components) while systems iterate
+// the containers of a registry and applies them at the sync point in the main loop, see flush().
+// Each container has its own typed list of commands, applied in the order they were recorded.
+// Recording is thread-safe, applying is not and must happen on the main thread.
+template <typename... Components>
+class RegistryCommands
+{
+	typedef Registry<Components...> Target;
+	typedef void (*Apply)(RegistryCommands&);
+
+	enum : unsigned int { REMOVE = 0xFFFFFFFFu };
+
+	template <typename Component>
+	struct Pending
+	{
+		std::vector<std::pair<Entity, unsigned int>> commands; // entity and index into added, or REMOVE
+		std::vector<Component> added;
+	};
+
+	Target& target;
+	std::mutex mutex;
+	std::tuple<Pending<Components>...> pending;
+	EntitySignatures::Mask touched = 0; // containers with pending commands
+	std::vector<Entity> destroyed;
+
+	template <typename Component>
+	Pending<Component>& pending_of()
+	{
+		return std::get<Target::template index_of<Component>()>(pending);
+	}
+
+	template <typename Component>
+	static void apply(RegistryCommands& buffer)
+	{
+		Pending<Component>& list = buffer.template pending_of<Component>();
+		auto& container = buffer.target.template get<Component>();
+		for (const std::pair<Entity, unsigned int>& command : list.commands)
+		{
+			if (command.second == REMOVE)
+				container.remove(command.first);
+			else if (command.first.alive())
+				container.insert(command.first, std::move(list.added[command.second]));
+		}
+		list.commands.clear();
+		list.added.clear();
+	}
+
+public:
+	explicit RegistryCommands(Target& target) : target(target) {}
+
+	// Hands out a new entity right away. Like Entity::create() this is for the main thread only,
+	// workers record commands for entities that were created before they started.
+	Entity create()
+	{
+		return Entity::create();
+	}
+
+	void destroy(Entity e)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		destroyed.push_back(e);
+	}
+
+	template <typename Component>
+	void add(Entity e, Component c)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Pending<Component>& list = pending_of<Component>();
+		list.commands.push_back({ e, (unsigned int)list.added.size() });
+		list.added.push_back(std::move(c));
+		touched |= EntitySignatures::Mask(1) << Target::template index_of<Component>();
+	}
+
+	template <typename Component>
+	void remove(Entity e)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending_of<Component>().commands.push_back({ e, REMOVE });
+		touched |= EntitySignatures::Mask(1) << Target::template index_of<Component>();
+	}
+
+	// Apply everything recorded so far, adds and removes first so that a destroy always wins.
+	// Nothing may be recorded while it runs.
+	void flush()
+	{
+		static const Apply appliers[] = { &RegistryCommands::apply<Components>... };
+		std::lock_guard<std::mutex> lock(mutex);
+		for (unsigned int i = 0; touched; i++, touched >>= 1)
+			if (touched & 1)
+				appliers[i](*this);
+
+		if (!destroyed.empty())
+		{
+			target.remove_all_components_of(destroyed);
+			destroyed.clear();
+		}
 	}
 };
@@ -1,3 +1,4 @@
 #include "tiny_ecs_registry.hpp"
 
-ECSRegistry registry;
\ No newline at end of file
+ECSRegistry registry;
+CommandBuffer command_buffer(registry);
\ No newline at end of file
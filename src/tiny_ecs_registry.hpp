@@ -4,138 +4,109 @@
 #include "tiny_ecs.hpp"
 #include "components.hpp"
 
-class ECSRegistry
+// All components this game has, add new component types to this list
+class ECSRegistry : public Registry<
+	RoomLevel,
+	CombatLevel,
+	EnterCombatTimer,
+	Combat,
+	MainWorld,
+	DeathTimer,
+	Motion,
+	ColliderLayer,
+	Player,
+	Mesh*,
+	RenderRequest,
+	ScreenState,
+	Enemy,
+	SwarmKing,
+	SwarmEnemy,
+	PinBallEnemy,
+	Room,
+	DebugComponent,
+	vec3,
+	physObj,
+	playerFlipper,
+	mousePos,
+	SpriteSheet,
+	HighLightEnemy,
+	Light,
+	PositionKeyFrame,
+	HealthBar,
+	PinballPlayerStatus,
+	DamageToPlayer,
+	DamageToEnemy,
+	TemporaryProjectile,
+	PinBall,
+	DropBuff,
+	Particle,
+	soundForPhys,
+	Maze,
+	Parallox,
+	PlayerBullet,
+	EnemyBullet,
+	Ball,
+	Spikes,
+	Door,
+	Zombie,
+	Sniper,
+	Boss>
 {
-	// Callbacks to remove a particular or all entities in the system
-	std::vector<ContainerInterface*> registry_list;
-
 public:
-	// Manually created list of all components this game has
-    ComponentContainer<RoomLevel> roomLevel;
-	ComponentContainer<CombatLevel> combatLevel;
-    ComponentContainer<EnterCombatTimer> enterCombatTimer;
-    ComponentContainer<Combat> combat;
-    ComponentContainer<MainWorld> mainWorld;
-	ComponentContainer<DeathTimer> deathTimers;
-	ComponentContainer<Motion> motions;
-	ComponentContainer<Collision> collisions;
-	ComponentContainer<Player> players;
-	ComponentContainer<Mesh*> meshPtrs;
-	ComponentContainer<RenderRequest> renderRequests;
-	ComponentContainer<ScreenState> screenStates;
-	ComponentContainer<Enemy> mainWorldEnemies;
-    ComponentContainer<SwarmKing> swarmKing;
-    ComponentContainer<SwarmEnemy> swarmEnemies;
-	ComponentContainer<PinBallEnemy> pinballEnemies;
-	ComponentContainer<Room> rooms;
-	ComponentContainer<DebugComponent> debugComponents;
-	ComponentContainer<vec3> colors;
-	ComponentContainer<physObj> physObjs;
-	ComponentContainer<playerFlipper> playerFlippers;
-	ComponentContainer<mousePos> mousePosArray;
-	ComponentContainer<SpriteSheet> spriteSheets;
-	ComponentContainer<HighLightEnemy> highLightEnemies;
-	ComponentContainer<Light> lights;
-	ComponentContainer<PositionKeyFrame> positionKeyFrames;
-	ComponentContainer<HealthBar> healthBar;
-	ComponentContainer<PinballPlayerStatus> pinballPlayerStatus;
-	ComponentContainer<DamageToPlayer> damages;
-	ComponentContainer<DamageToEnemy> attackPower;
-	ComponentContainer<TemporaryProjectile> temporaryProjectiles;
-	ComponentContainer<PinBall> pinBalls;
-	ComponentContainer<DropBuff> dropBuffs;
-	ComponentContainer<Particle> particles;
-	ComponentContainer<soundForPhys> sfx;
-	ComponentContainer<Maze> mazes;
-	ComponentContainer<Parallox> paras;
-	
-	// World assets
-	ComponentContainer<PlayerBullet> playerBullets;
-	ComponentContainer<EnemyBullet> enemyBullets;
-	ComponentContainer<Ball> balls;
-	ComponentContainer<Spikes> spikes;
-	ComponentContainer<Door> doors;
-
-	ComponentContainer<Zombie> zombies;
-	ComponentContainer<Sniper> snipers;
-	ComponentContainer<Boss> bosses;
-
-	// constructor that adds all containers for looping over them
-	// IMPORTANT: Don't forget to add any newly added containers!
-	ECSRegistry()
-	{
-        registry_list.push_back(&roomLevel);
-        registry_list.push_back(&combatLevel);
-        registry_list.push_back(&combat);
-		registry_list.push_back(&mainWorld);
-		registry_list.push_back(&deathTimers);
-		registry_list.push_back(&motions);
-		registry_list.push_back(&collisions);
-		registry_list.push_back(&players);
-		registry_list.push_back(&meshPtrs);
-		registry_list.push_back(&renderRequests);
-		registry_list.push_back(&screenStates);
-		registry_list.push_back(&mainWorldEnemies);
-        registry_list.push_back(&swarmKing);
-        registry_list.push_back(&swarmEnemies);
-		registry_list.push_back(&pinballEnemies);
-		registry_list.push_back(&rooms);
-		registry_list.push_back(&debugComponents);
-		registry_list.push_back(&colors);
-		registry_list.push_back(&physObjs);
-		registry_list.push_back(&playerFlippers);
-		registry_list.push_back(&mousePosArray);
-		registry_list.push_back(&spriteSheets);
-		registry_list.push_back(&highLightEnemies);
-		registry_list.push_back(&lights);
-		registry_list.push_back(&positionKeyFrames);
-		registry_list.push_back(&healthBar);
-		registry_list.push_back(&pinballPlayerStatus);
-		registry_list.push_back(&damages);
-		registry_list.push_back(&attackPower);
-		registry_list.push_back(&temporaryProjectiles);
-		registry_list.push_back(&pinBalls);
-		registry_list.push_back(&dropBuffs);
-		registry_list.push_back(&particles);
-		registry_list.push_back(&sfx);
-		registry_list.push_back(&mazes);
-		registry_list.push_back(&paras);
-
-		// World assets
-		registry_list.push_back(&playerBullets);
-		registry_list.push_back(&enemyBullets);
-		registry_list.push_back(&balls);
-		registry_list.push_back(&spikes);
-		registry_list.push_back(&doors);
+	// Container names used by the game code, aliases of get<Component>()
+	ComponentContainer<RoomLevel>& roomLevel = get<RoomLevel>();
+	ComponentContainer<CombatLevel>& combatLevel = get<CombatLevel>();
+	ComponentContainer<EnterCombatTimer>& enterCombatTimer = get<EnterCombatTimer>();
+	TagContainer<Combat>& combat = get<Combat>();
+	TagContainer<MainWorld>& mainWorld = get<MainWorld>();
+	ComponentContainer<DeathTimer>& deathTimers = get<DeathTimer>();
+	ComponentContainer<Motion>& motions = get<Motion>();
+	ComponentContainer<ColliderLayer>& colliderLayers = get<ColliderLayer>();
+	ComponentContainer<Player>& players = get<Player>();
+	ComponentContainer<Mesh*>& meshPtrs = get<Mesh*>();
+	ComponentContainer<RenderRequest>& renderRequests = get<RenderRequest>();
+	ComponentContainer<ScreenState>& screenStates = get<ScreenState>();
+	ComponentContainer<Enemy>& mainWorldEnemies = get<Enemy>();
+	TagContainer<SwarmKing>& swarmKing = get<SwarmKing>();
+	ComponentContainer<SwarmEnemy>& swarmEnemies = get<SwarmEnemy>();
+	ComponentContainer<PinBallEnemy>& pinballEnemies = get<PinBallEnemy>();
+	ComponentContainer<Room>& rooms = get<Room>();
+	TagContainer<DebugComponent>& debugComponents = get<DebugComponent>();
+	ComponentContainer<vec3>& colors = get<vec3>();
+	ComponentContainer<physObj>& physObjs = get<physObj>();
+	ComponentContainer<playerFlipper>& playerFlippers = get<playerFlipper>();
+	ComponentContainer<mousePos>& mousePosArray = get<mousePos>();
+	ComponentContainer<SpriteSheet>& spriteSheets = get<SpriteSheet>();
+	ComponentContainer<HighLightEnemy>& highLightEnemies = get<HighLightEnemy>();
+	ComponentContainer<Light>& lights = get<Light>();
+	ComponentContainer<PositionKeyFrame>& positionKeyFrames = get<PositionKeyFrame>();
+	ComponentContainer<HealthBar>& healthBar = get<HealthBar>();
+	ComponentContainer<PinballPlayerStatus>& pinballPlayerStatus = get<PinballPlayerStatus>();
+	ComponentContainer<DamageToPlayer>& damages = get<DamageToPlayer>();
+	ComponentContainer<DamageToEnemy>& attackPower = get<DamageToEnemy>();
+	ComponentContainer<TemporaryProjectile>& temporaryProjectiles = get<TemporaryProjectile>();
+	ComponentContainer<PinBall>& pinBalls = get<PinBall>();
+	ComponentContainer<DropBuff>& dropBuffs = get<DropBuff>();
+	ComponentContainer<Particle>& particles = get<Particle>();
+	ComponentContainer<soundForPhys>& sfx = get<soundForPhys>();
+	TagContainer<Maze>& mazes = get<Maze>();
+	ComponentContainer<Parallox>& paras = get<Parallox>();
 
-		registry_list.push_back(&zombies);
-		registry_list.push_back(&snipers);
-		registry_list.push_back(&bosses);
-	}
-
-	void clear_all_components() {
-		for (ContainerInterface* reg : registry_list)
-			reg->clear();
-	}
+	// World assets
+	TagContainer<PlayerBullet>& playerBullets = get<PlayerBullet>();
+	TagContainer<EnemyBullet>& enemyBullets = get<EnemyBullet>();
+	ComponentContainer<Ball>& balls = get<Ball>();
+	TagContainer<Spikes>& spikes = get<Spikes>();
+	TagContainer<Door>& doors = get<Door>();
 
-	void list_all_components() {
-		printf("Debug info on all registry entries:\n");
-		for (ContainerInterface* reg : registry_list)
-			if (reg->size() > 0)
-				printf("%4d components of type %s\n", (int)reg->size(), typeid(*reg).name());
-	}
+	TagContainer<Zombie>& zombies = get<Zombie>();
+	TagContainer<Sniper>& snipers = get<Sniper>();
+	TagContainer<Boss>& bosses = get<Boss>();
+};
 
-	void list_all_components_of(Entity e) {
-		printf("Debug info on components of entity %u:\n", (unsigned int)e);
-		for (ContainerInterface* reg : registry_list)
-			if (reg->has(e))
-				printf("type %s\n", typeid(*reg).name());
-	}
+extern ECSRegistry registry;
 
-	void remove_all_components_of(Entity e) {
-		for (ContainerInterface* reg : registry_list)
-			reg->remove(e);
-	}
-};
+// Structural changes recorded by the systems, applied once per frame in the main loop
+typedef ECSRegistry::Commands CommandBuffer;
 
-extern ECSRegistry registry;
\ No newline at end of file
+extern CommandBuffer command_buffer;
\ No newline at end of file
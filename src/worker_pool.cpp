@@ -0,0 +1,106 @@
+// internal
+#include "worker_pool.hpp"
+
+// stlib
+#include <algorithm>
+
+WorkerPool::~WorkerPool()
+{
+	stop();
+}
+
+void WorkerPool::set_threads(int threads)
+{
+	if (threads <= 0)
+		threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	stop();
+	stopping = false;
+	for (int i = 1; i < threads; i++)
+		workers.emplace_back(&WorkerPool::work, this);
+}
+
+void WorkerPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+void WorkerPool::run_chunks(const std::function<void(int, int)>& job, int count, int grain)
+{
+	for (;;)
+	{
+		int begin = next.fetch_add(grain);
+		if (begin >= count)
+			return;
+		job(begin, std::min(begin + grain, count));
+	}
+}
+
+void WorkerPool::work()
+{
+	unsigned int seen = 0;
+	for (;;)
+	{
+		const std::function<void(int, int)>* current;
+		int current_count;
+		int current_grain;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+			current = job;
+			current_count = count;
+			current_grain = grain;
+			busy++;
+		}
+
+		// parallel_for waits for busy to drop back to zero, the job stays alive until then
+		run_chunks(*current, current_count, current_grain);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busy--;
+		}
+		done.notify_one();
+	}
+}
+
+void WorkerPool::parallel_for(int count, int grain, const std::function<void(int, int)>& job)
+{
+	if (count <= 0)
+		return;
+
+	// not worth waking anyone up for a single chunk
+	if (workers.empty() || count <= grain)
+	{
+		job(0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		grain = std::max(1, grain);
+		this->job = &job;
+		this->count = count;
+		this->grain = grain;
+		next = 0;
+		generation++;
+	}
+	wake.notify_all();
+
+	run_chunks(job, count, grain);
+
+	// workers that woke up late find no chunks left and leave right away
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [&] { return busy == 0 && next >= this->count; });
+	this->job = nullptr;
+}
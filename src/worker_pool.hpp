@@ -0,0 +1,49 @@
+#pragma once
+
+// stlib
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that run parallel_for jobs. The calling thread works on the job too, so a pool
+// of one thread runs everything inline. Only one job runs at a time and parallel_for blocks until it
+// is done.
+class WorkerPool
+{
+public:
+	WorkerPool() {}
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Total threads including the caller, 0 picks one per hardware thread
+	void set_threads(int threads);
+	int threads() const { return (int)workers.size() + 1; }
+
+	// Calls job(begin, end) on chunks of at most grain items until [0, count) is covered
+	void parallel_for(int count, int grain, const std::function<void(int, int)>& job);
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// the current job, workers pick it up when generation changes. job, count and grain are only
+	// written and read under the mutex, each thread runs on its own copy of them.
+	const std::function<void(int, int)>* job = nullptr;
+	int count = 0;
+	int grain = 1;
+	std::atomic<int> next{ 0 };
+	unsigned int generation = 0;
+	int busy = 0;
+	bool stopping = false;
+
+	void run_chunks(const std::function<void(int, int)>& job, int count, int grain);
+	void work();
+	void stop();
+};
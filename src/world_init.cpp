@@ -1,14 +1,42 @@
 #include "world_init.hpp"
 #include "tiny_ecs_registry.hpp"
 #include "world_system.hpp"
+#include "tile_map.hpp"
 #include <iostream>
 #include <random>
 #include <cstdlib>
 #include <ctime> 
 
+ColliderLayer colliderLayerFor(COLLIDER_LAYER layer)
+{
+	// Keep the table symmetric, a pair is only tested if both sides list each other
+	ColliderLayer collider;
+	collider.layer = layer;
+	switch (layer)
+	{
+	case LAYER_PLAYER:
+		collider.mask = LAYER_ENEMY | LAYER_ENEMY_BULLET | LAYER_DROP;
+		break;
+	case LAYER_ENEMY:
+		collider.mask = LAYER_PLAYER | LAYER_PLAYER_BULLET;
+		break;
+	case LAYER_PLAYER_BULLET:
+		collider.mask = LAYER_ENEMY | LAYER_ENEMY_BULLET;
+		break;
+	case LAYER_ENEMY_BULLET:
+		collider.mask = LAYER_PLAYER | LAYER_PLAYER_BULLET;
+		break;
+	default:
+		// drops only react to the player
+		collider.mask = LAYER_PLAYER;
+		break;
+	}
+	return collider;
+}
+
 Entity createDropBuff(RenderSystem* renderer, vec2 pos, TEXTURE_ASSET_ID id)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
@@ -18,6 +46,7 @@ Entity createDropBuff(RenderSystem* renderer, vec2 pos, TEXTURE_ASSET_ID id)
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.scale = mesh.original_size * 50.f;
+	registry.colliderLayers.insert(entity, colliderLayerFor(LAYER_DROP));
 	registry.renderRequests.insert(
 		entity,
 		{ id,
@@ -32,7 +61,7 @@ Entity createDropBuff(RenderSystem* renderer, vec2 pos, TEXTURE_ASSET_ID id)
 
 Entity createShadow(RenderSystem* renderer, vec2 pos)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
@@ -54,7 +83,7 @@ Entity createShadow(RenderSystem* renderer, vec2 pos)
 
 Entity createPinballWall(RenderSystem* renderer, const std::vector<vec2>& vertices, GEOMETRY_BUFFER_ID id)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::RECT);
     registry.combat.emplace(entity);
 
@@ -89,7 +118,7 @@ Entity createPinballWall(RenderSystem* renderer, const std::vector<vec2>& vertic
 
 Entity createPinballFlipper(RenderSystem* renderer, const std::vector<vec2>& vertices, GEOMETRY_BUFFER_ID id)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::RECT);
 	registry.combat.emplace(entity);
 
@@ -129,7 +158,7 @@ Entity createPlayer(RenderSystem* renderer, vec2 pos, float currentHealth)
 	Entity healthAmortized = createHealth(renderer, { pos.x, pos.y-50 }, false);
 	registry.colors.insert(healthAmortized, { 1, 1, 1 });
 
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
     registry.mainWorld.emplace(entity);
@@ -144,6 +173,7 @@ Entity createPlayer(RenderSystem* renderer, vec2 pos, float currentHealth)
 
 	Player& player = registry.players.emplace(entity);
 	player.currentHealth = currentHealth;
+	registry.colliderLayers.insert(entity, colliderLayerFor(LAYER_PLAYER));
 
 	registry.renderRequests.insert(
 	entity,
@@ -167,7 +197,7 @@ Entity createPlayer(RenderSystem* renderer, vec2 pos, float currentHealth)
 
 Entity createRoomEnemy(RenderSystem* renderer, vec2 pos, vec2 roomPostion, float roomScale, bool keyFrame)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 	registry.mainWorld.emplace(entity);
@@ -181,6 +211,7 @@ Entity createRoomEnemy(RenderSystem* renderer, vec2 pos, vec2 roomPostion, float
 
 	// registry.players.emplace(entity);
 	registry.mainWorldEnemies.emplace(entity);
+	registry.colliderLayers.insert(entity, colliderLayerFor(LAYER_ENEMY));
 	registry.renderRequests.insert(
 		entity,
 		{ TEXTURE_ASSET_ID::ENEMYWALKSPRITESHEET,
@@ -215,7 +246,7 @@ Entity createRoomEnemy(RenderSystem* renderer, vec2 pos, vec2 roomPostion, float
 
 Entity createRoomSniper(RenderSystem* renderer, vec2 pos, vec2 roomPostion, float roomScale, bool keyFrame)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 	registry.mainWorld.emplace(entity);
@@ -229,6 +260,7 @@ Entity createRoomSniper(RenderSystem* renderer, vec2 pos, vec2 roomPostion, floa
 
 	// registry.players.emplace(entity);
 	registry.mainWorldEnemies.emplace(entity);
+	registry.colliderLayers.insert(entity, colliderLayerFor(LAYER_ENEMY));
 	registry.snipers.emplace(entity);
 	registry.renderRequests.insert(
 		entity,
@@ -257,7 +289,7 @@ Entity createRoomSniper(RenderSystem* renderer, vec2 pos, vec2 roomPostion, floa
 
 Entity createRoomZombie(RenderSystem* renderer, vec2 pos, vec2 roomPostion, float roomScale, bool keyFrame)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 	registry.mainWorld.emplace(entity);
@@ -271,6 +303,7 @@ Entity createRoomZombie(RenderSystem* renderer, vec2 pos, vec2 roomPostion, floa
 
 	// registry.players.emplace(entity);
 	registry.mainWorldEnemies.emplace(entity);
+	registry.colliderLayers.insert(entity, colliderLayerFor(LAYER_ENEMY));
 	registry.zombies.emplace(entity);
 	registry.renderRequests.insert(
 		entity,
@@ -299,7 +332,7 @@ Entity createRoomZombie(RenderSystem* renderer, vec2 pos, vec2 roomPostion, floa
 
 Entity createRoom(RenderSystem* renderer, vec2 pos, GLFWwindow* window, int room_num)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	switch (room_num) {
 	case -1:
 		return createEmptyRoom(renderer, pos, window);
@@ -336,7 +369,7 @@ Entity createRoom(RenderSystem* renderer, vec2 pos, GLFWwindow* window, int room
 
 
 Entity createBar(RenderSystem* renderer, vec2 pos, vec2 scale) {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::ROAD);
 	registry.meshPtrs.emplace(entity, &mesh);
 
@@ -348,6 +381,7 @@ Entity createBar(RenderSystem* renderer, vec2 pos, vec2 scale) {
 	motion.scale = mesh.original_size * scale;
 
 	registry.mazes.emplace(entity);
+	room_tiles.mark(pos - abs(motion.scale) / 2.f, pos + abs(motion.scale) / 2.f, TILE_WALL);
 	registry.renderRequests.insert(
 		entity,
 		{ TEXTURE_ASSET_ID::TEXTURE_COUNT,
@@ -359,7 +393,7 @@ Entity createBar(RenderSystem* renderer, vec2 pos, vec2 scale) {
 
 Entity createMaze1(RenderSystem* renderer, vec2 pos)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 	registry.mainWorld.emplace(entity);
@@ -383,14 +417,9 @@ Entity createMaze1(RenderSystem* renderer, vec2 pos)
 			GEOMETRY_BUFFER_ID::SPRITE });
 
 	// Add door
-	Entity door = createDoor({ 0,0 }, { 0,0 }); //intialized below
-	Motion& door_motion = registry.motions.get(door);
 	float door_width = 50;
 	float door_height = 60;
-	door_motion.position = { window_width_px / 2.f - door_width / 2.f, door_height / 2.f };
-	door_motion.scale = { door_width, door_height };
-	door_motion.angle = 0;
-	door_motion.velocity = { 0,0 };
+	Entity door = createDoor({ window_width_px / 2.f - door_width / 2.f, door_height / 2.f }, { door_width, door_height });
 	registry.colors.insert(door, { 0, 0, 0 });
 
 	createBar(renderer, { 250.f, 250.f }, { 50.f, 50.f });
@@ -400,7 +429,7 @@ Entity createMaze1(RenderSystem* renderer, vec2 pos)
 
 Entity createEmptyRoom(RenderSystem* renderer, vec2 pos, GLFWwindow* window)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 	registry.mainWorld.emplace(entity);
@@ -439,7 +468,7 @@ Entity createEmptyRoom(RenderSystem* renderer, vec2 pos, GLFWwindow* window)
 
 Entity createStartingRoom(RenderSystem* renderer, vec2 pos, GLFWwindow* window)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 	registry.mainWorld.emplace(entity);
@@ -487,14 +516,9 @@ Entity createStartingRoom(RenderSystem* renderer, vec2 pos, GLFWwindow* window)
 	printf("This is window size in starting room: %d, %d\n", w, h);
 
 	// Add door
-	Entity door = createDoor({ 0,0 }, { 0,0 }); //intialized below
-	Motion& door_motion = registry.motions.get(door);
 	float door_width = 50;
 	float door_height = 60;
-	door_motion.position = { window_width_px / 2.f - door_width / 2.f, door_height / 2.f };
-	door_motion.scale = { door_width, door_height };
-	door_motion.angle = 0;
-	door_motion.velocity = { 0,0 };
+	Entity door = createDoor({ window_width_px / 2.f - door_width / 2.f, door_height / 2.f }, { door_width, door_height });
 	registry.colors.insert(door, { 0, 0, 0 });
 
 	// Add spikes
@@ -538,7 +562,7 @@ Entity createStartingRoom(RenderSystem* renderer, vec2 pos, GLFWwindow* window)
 
 Entity createRoom1(RenderSystem* renderer, vec2 pos)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 	registry.mainWorld.emplace(entity);
@@ -592,7 +616,7 @@ Entity createRoom1(RenderSystem* renderer, vec2 pos)
 
 Entity createRoom2(RenderSystem* renderer, vec2 pos)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 	registry.mainWorld.emplace(entity);
@@ -648,7 +672,7 @@ Entity createRoom2(RenderSystem* renderer, vec2 pos)
 
 Entity createRoom3(RenderSystem* renderer, vec2 pos)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 	registry.mainWorld.emplace(entity);
@@ -713,7 +737,7 @@ Entity* createPinballRoom(RenderSystem* renderer, vec2 pos, GLFWwindow* window)
 	auto entities = new Entity[8];
 	TEXTURE_ASSET_ID textures[8] = {TEXTURE_ASSET_ID::PINBALLBACKGROUND1, TEXTURE_ASSET_ID::PINBALLBACKGROUND2, TEXTURE_ASSET_ID::PINBALLBACKGROUND3, TEXTURE_ASSET_ID::PINBALLBACKGROUND4, TEXTURE_ASSET_ID::PINBALLBACKGROUND5, TEXTURE_ASSET_ID::PINBALLBACKGROUND6, TEXTURE_ASSET_ID::PINBALLBACKGROUND7, TEXTURE_ASSET_ID::PINBALLBACKGROUND8};
 	for (int i=0; i<8; i++) {
-		auto entity = Entity();
+		auto entity = Entity::create();
 		Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 		registry.meshPtrs.emplace(entity, &mesh);
 		registry.combat.emplace(entity);
@@ -744,7 +768,7 @@ Entity* createPinballRoom(RenderSystem* renderer, vec2 pos, GLFWwindow* window)
 
 Entity createHealth(RenderSystem* renderer, vec2 pos, bool combat)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::PINBALLENEMYBLOOD);
 	registry.meshPtrs.emplace(entity, &mesh);
 
@@ -770,7 +794,7 @@ Entity createHealth(RenderSystem* renderer, vec2 pos, bool combat)
 Entity createSwarmEnemy(RenderSystem* renderer, vec2 pos)
 {
     float scale = 25.f;
-    auto entity = Entity();
+    auto entity = Entity::create();
     Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SWARMENEMY);
     registry.meshPtrs.emplace(entity, &mesh);
 
@@ -803,7 +827,7 @@ Entity createSwarmEnemy(RenderSystem* renderer, vec2 pos)
  Entity createPinBallEnemy(RenderSystem *renderer, vec2 pos, vec2 boundary, float xScale, int attackType, float attackCd,
                     float yScale)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::PINBALLENEMY);
 	registry.meshPtrs.emplace(entity, &mesh);
 
@@ -844,13 +868,15 @@ Entity createSwarmEnemy(RenderSystem* renderer, vec2 pos)
 			EFFECT_ASSET_ID::SALMON,
 			GEOMETRY_BUFFER_ID::OCT });
 	createNewRectangleTiedToEntity(entity, mesh.original_size.x * xScale*50.f, mesh.original_size.y*50.f, registry.motions.get(entity).position, false, 1.0);
+	// the AI moves it through its accel
+	registry.physObjs.get(entity).state = BODY_STATE::KINEMATIC;
 
 	return entity;
 }
 
 Entity createBall(RenderSystem* renderer, vec2 pos, float size, float trail, bool isMainBall)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::BALL);
 	registry.meshPtrs.emplace(entity, &mesh);
 
@@ -867,6 +893,9 @@ Entity createBall(RenderSystem* renderer, vec2 pos, float size, float trail, boo
 	ball.trail = trail;
     ball.isMainBall = isMainBall;
 
+	// as wide as the square body the balls used to have
+	createNewCircleTiedToEntity(entity, size * 0.5f, pos, true, 1.f);
+
 	// registry.players.emplace(entity);
 	registry.renderRequests.insert(
 		entity,
@@ -880,7 +909,7 @@ Entity createBall(RenderSystem* renderer, vec2 pos, float size, float trail, boo
 
 Entity createDoor(vec2 pos, vec2 size)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 
 	// Setting initial motion values
 	Motion& motion = registry.motions.emplace(entity);
@@ -890,6 +919,7 @@ Entity createDoor(vec2 pos, vec2 size)
 	motion.scale = size;
 
 	registry.doors.emplace(entity);
+	room_tiles.mark(pos - size / 2.f, pos + size / 2.f, TILE_DOOR);
 
 	registry.renderRequests.insert(
 		entity,
@@ -902,7 +932,7 @@ Entity createDoor(vec2 pos, vec2 size)
 
 Entity createSpikes(vec2 pos, vec2 size)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 
 	// Setting initial motion values
 	Motion& motion = registry.motions.emplace(entity);
@@ -912,6 +942,7 @@ Entity createSpikes(vec2 pos, vec2 size)
 	motion.scale = size * 0.75f;
 
 	registry.spikes.emplace(entity);
+	room_tiles.mark(pos - motion.scale / 2.f, pos + motion.scale / 2.f, TILE_SPIKES);
 
 	registry.renderRequests.insert(
 		entity,
@@ -924,7 +955,7 @@ Entity createSpikes(vec2 pos, vec2 size)
 
 Entity createPlayerBullet(vec2 pos, vec2 size)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 
 	// Setting initial motion values
 	Motion& motion = registry.motions.emplace(entity);
@@ -934,6 +965,7 @@ Entity createPlayerBullet(vec2 pos, vec2 size)
 	motion.scale = size * 0.7f;
 
 	registry.playerBullets.emplace(entity);
+	registry.colliderLayers.insert(entity, colliderLayerFor(LAYER_PLAYER_BULLET));
 
 	registry.renderRequests.insert(
 		entity,
@@ -949,7 +981,7 @@ Entity createPlayerBullet(vec2 pos, vec2 size)
 
 Entity createEnemyBullet(vec2 pos, vec2 size)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 
 	// Setting initial motion values
 	Motion& motion = registry.motions.emplace(entity);
@@ -959,6 +991,7 @@ Entity createEnemyBullet(vec2 pos, vec2 size)
 	motion.scale = size * 0.7f;
 
 	registry.enemyBullets.emplace(entity);
+	registry.colliderLayers.insert(entity, colliderLayerFor(LAYER_ENEMY_BULLET));
 
 	registry.renderRequests.insert(
 		entity,
@@ -975,7 +1008,7 @@ Entity createEnemyBullet(vec2 pos, vec2 size)
 
 Entity createParticle(RenderSystem* renderer, vec2 pos, float size, vec2 vel, vec3 color, float lifespan)
 {
-	auto entity = Entity();
+	auto entity = Entity::create();
 
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::BALL);
 	registry.meshPtrs.emplace(entity, &mesh);
@@ -1005,90 +1038,89 @@ Entity createParticle(RenderSystem* renderer, vec2 pos, float size, vec2 vel, ve
 }
 
 
-void createNewRectangleTiedToEntity(Entity e, float w, float h, vec2 centerPos, bool moveable, float knockbackCoef) {
-
-
-	//	auto& entity = Entity();
-
-	Vertex_Phys newV{};
-	registry.physObjs.emplace(e);
-	physObj test0 = registry.physObjs.components[0];
+void createNewCircleTiedToEntity(Entity e, float radius, vec2 centerPos, bool moveable, float knockbackCoef) {
 
-
-	//	0-----1
-	//	|	  |
-	//	3-----2
-
-	physObj& newObj = registry.physObjs.get(e);
+	physObj& newObj = registry.physObjs.emplace(e);
 
 	newObj.moveable = moveable;
 	newObj.knockbackCoef = knockbackCoef;
+	newObj.ccd = registry.balls.has(e);
+	newObj.state = moveable ? BODY_STATE::DYNAMIC : BODY_STATE::STATIC;
 
-	newV.pos = vec2(centerPos.x - w / 2, centerPos.y + h / 2);
-	newV.oldPos = vec2(centerPos.x - w / 2, centerPos.y + h / 2);
-	newV.accel = vec2(0.0, 0.0);
-
-
-	newObj.Vertices[0] = newV;
-
-	newV.pos = vec2(centerPos.x + w / 2, centerPos.y + h / 2);
-	newV.oldPos = vec2(centerPos.x + w / 2, centerPos.y + h / 2);
-
-	newObj.Vertices[1] = newV;
-
-	newV.pos = vec2(centerPos.x - w / 2, centerPos.y - h / 2);
-	newV.oldPos = vec2(centerPos.x - w / 2, centerPos.y - h / 2);
-
-	newObj.Vertices[3] = newV;
-
-	newV.pos = vec2(centerPos.x + w / 2, centerPos.y - h / 2);
-	newV.oldPos = vec2(centerPos.x + w / 2, centerPos.y - h / 2);
-
-
-	newObj.Vertices[2] = newV;
-
-	newObj.VertexCount = 4;
-
-	physObj test1 = registry.physObjs.components[0];
-
-	Edge newEdge{};
-
-
-
-	newObj.Edges[0].v1 = 0;
-	newObj.Edges[0].v2 = 1;
-	newObj.Edges[0].len = w;
-
-
-	newObj.Edges[1].v1 = 1;
-	newObj.Edges[1].v2 = 2;
-	newObj.Edges[1].len = h;
-
-
-
-	newObj.Edges[2].v1 = 2;
-	newObj.Edges[2].v2 = 3;
-	newObj.Edges[2].len = w;
-
-	physObj test2 = registry.physObjs.components[0];
-
-
-	newObj.Edges[3].v1 = 3;
-	newObj.Edges[3].v2 = 0;
-	newObj.Edges[3].len = h;
+	newObj.radius = radius;
+	newObj.VertexCount = 1;
+	newObj.EdgesCount = 0;
+	newObj.Vertices.offset = phys_pool.allocVertices(1);
+	newObj.Edges.offset = phys_pool.allocEdges(0);
+	newObj.Vertices[0].pos = centerPos;
+	newObj.Vertices[0].oldPos = centerPos;
 
+	newObj.center = centerPos;
+	newObj.prevCenter = centerPos;
+	newObj.prevAngle = 0.f;
+}
 
+void createNewPolygonTiedToEntity(Entity e, const std::vector<vec2>& vertices, bool moveable, float knockbackCoef) {
 
-	newObj.Edges[4].v1 = 0;
-	newObj.Edges[4].v2 = 2;
-	newObj.Edges[4].len = sqrt(h * h + w * w);
+	const int count = (int)vertices.size();
+	assert(count >= 3);
 
+	physObj& newObj = registry.physObjs.emplace(e);
 
+	newObj.moveable = moveable;
+	newObj.knockbackCoef = knockbackCoef;
+	// balls and the temporary projectiles are the only bodies fast enough to tunnel
+	newObj.ccd = registry.balls.has(e);
+	newObj.state = moveable ? BODY_STATE::DYNAMIC : BODY_STATE::STATIC;
+
+	// The outline, then braces that keep the shape rigid. A quad gets the one diagonal the
+	// rectangles always had, bigger polygons are braced to the vertex after the next one and
+	// across, a fan from one vertex is too soft with a single relaxation pass per substep.
+	std::vector<Edge> edges;
+	for (int i = 0; i < count; i++)
+		edges.push_back({ i, (i + 1) % count, 0.f });
+	if (count == 4)
+		edges.push_back({ 0, 2, 0.f });
+	if (count >= 5)
+		for (int i = 0; i < count; i++)
+			edges.push_back({ i, (i + 2) % count, 0.f });
+	if (count >= 6)
+		for (int i = 0; i < count / 2; i++)
+			edges.push_back({ i, i + count / 2, 0.f });
+
+	newObj.VertexCount = count;
+	newObj.EdgesCount = (int)edges.size();
+	newObj.Vertices.offset = phys_pool.allocVertices(newObj.VertexCount);
+	newObj.Edges.offset = phys_pool.allocEdges(newObj.EdgesCount);
+
+	vec2 center = vec2(0.f);
+	for (int i = 0; i < count; i++)
+	{
+		newObj.Vertices[i].pos = vertices[i];
+		newObj.Vertices[i].oldPos = vertices[i];
+		center += vertices[i];
+	}
 
+	for (int i = 0; i < newObj.EdgesCount; i++)
+	{
+		edges[i].len = length(vertices[edges[i].v2] - vertices[edges[i].v1]);
+		newObj.Edges[i] = edges[i];
+	}
 
+	newObj.center = center / (float)count;
+	newObj.prevCenter = newObj.center;
+	newObj.prevAngle = atan2(vertices[1].y - vertices[0].y, vertices[1].x - vertices[0].x);
+}
 
-	newObj.EdgesCount = 5;
+void createNewRectangleTiedToEntity(Entity e, float w, float h, vec2 centerPos, bool moveable, float knockbackCoef) {
 
-	newObj.center = centerPos;
+	//	0-----1
+	//	|	  |
+	//	3-----2
 
+	createNewPolygonTiedToEntity(e, {
+		vec2(centerPos.x - w / 2, centerPos.y + h / 2),
+		vec2(centerPos.x + w / 2, centerPos.y + h / 2),
+		vec2(centerPos.x + w / 2, centerPos.y - h / 2),
+		vec2(centerPos.x - w / 2, centerPos.y - h / 2) }, moveable, knockbackCoef);
 }
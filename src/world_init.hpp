@@ -66,6 +66,12 @@ Entity createParticle(RenderSystem* renderer, vec2 pos, float size, vec2 vel, ve
 Entity createPlayerBullet(vec2 pos, vec2 size);
 Entity createEnemyBullet(vec2 pos, vec2 size);
 
+// collision layer and the layers it interacts with, for the world mode collision check
+ColliderLayer colliderLayerFor(COLLIDER_LAYER layer);
+
+void createNewCircleTiedToEntity(Entity e, float radius, vec2 centerPos, bool moveable, float knockbackCoef);
+// vertices of a convex polygon in order around it, any count from 3
+void createNewPolygonTiedToEntity(Entity e, const std::vector<vec2>& vertices, bool moveable, float knockbackCoef);
 void createNewRectangleTiedToEntity(Entity e, float w, float h, vec2 centerPos, bool moveable, float knockbackCoef);
 
 
@@ -9,6 +9,8 @@
 
 #include "physics_system.hpp"
 #include "pinball_system.hpp"
+#include "contact_stream.hpp"
+#include "tile_map.hpp"
 
 // For saving/loading game state
 #include <../ext/nlohmann/json.hpp>
@@ -40,7 +42,7 @@ WorldSystem::WorldSystem()
 {
 	// Seeding rng with random device
 	rng = std::default_random_engine(std::random_device()());
-    auto e = Entity();
+    auto e = Entity::create();
     registry.roomLevel.emplace(e);
     this->curr_rooom = e;
 }
@@ -170,7 +172,11 @@ GLFWwindow *WorldSystem::create_window()
 	flipper_sound = Mix_LoadWAV(audio_path("flipperSound.wav").c_str());
 	player_hit_sound = Mix_LoadWAV(audio_path("playerHitSound.wav").c_str());
 
-	Entity sounds = Entity();
+	// sounds are referenced by soundForPhys, snapshots store them by id
+	for (Mix_Chunk* chunk : { salmon_dead_sound, player_attack_sound, enemy_death_sound, dash_sound, enemy_hit_sound, flipper_sound, player_hit_sound })
+		snapshot_assets.add(chunk);
+
+	Entity sounds = Entity::create();
 	soundForPhys s;
 	s.enemy_death_sound = enemy_death_sound;
 	s.enemy_hit_sound = enemy_hit_sound;
@@ -231,6 +237,7 @@ void WorldSystem::restart_game()
 	{
 		while (registry.motions.entities.size() > 0)
 			registry.remove_all_components_of(registry.motions.entities.back());
+		bake_room_tiles();
 
 		registry.list_all_components();
 
@@ -260,6 +267,7 @@ void WorldSystem::restart_game()
 	// All that have a motion, we could also iterate over all fish, turtles, ... but that would be more cumbersome
 	while (registry.motions.entities.size() > 0)
 		registry.remove_all_components_of(registry.motions.entities.back());
+	bake_room_tiles();
 
 	// Debugging for memory/component leaks
 	registry.list_all_components();
@@ -424,14 +432,9 @@ void WorldSystem::load_game(const std::string &filename)
 
 				// Add door
 				if (registry.roomLevel.get(curr_rooom).counter != 7) {
-					Entity door = createDoor({ 0,0 }, { 0,0 }); //intialized below
-					Motion& door_motion = registry.motions.get(door);
 					float door_width = 50;
 					float door_height = 60;
-					door_motion.position = { window_width_px / 2.f - door_width / 2.f, door_height / 2.f };
-					door_motion.scale = { door_width, door_height };
-					door_motion.angle = 0;
-					door_motion.velocity = { 0,0 };
+					Entity door = createDoor({ window_width_px / 2.f - door_width / 2.f, door_height / 2.f }, { door_width, door_height });
 					registry.colors.insert(door, { 0, 0, 0 });
 				}
 			}
@@ -441,6 +444,9 @@ void WorldSystem::load_game(const std::string &filename)
 			}
 		}
 
+		// the spikes removed above are still in the grid
+		bake_room_tiles();
+
 		file.close();
 		std::cout << "Position loaded successfully." << std::endl;
 	}
@@ -660,7 +666,7 @@ void WorldSystem::on_mouse_move(vec2 mouse_position)
 
 	if (registry.mousePosArray.size() == 0)
 	{
-		Entity e;
+		Entity e = Entity::create();
 		mousePos mp;
 		mp.pos = mouse_position;
 		registry.mousePosArray.insert(e, mp);
@@ -900,6 +906,7 @@ void WorldSystem::enter_next_room()
 	// Remove all entities that we created
 	while (registry.motions.entities.size() > 0)
 		registry.remove_all_components_of(registry.motions.entities.back());
+	bake_room_tiles();
 
     registry.roomLevel.get(curr_rooom).counter += 1;
 	rooms[0] = createRoom(renderer, {600, 400}, window, registry.roomLevel.get(curr_rooom).counter);
@@ -995,189 +1002,179 @@ void WorldSystem::save_player_last_direction()
 	}
 }
 
-// Compute collisions between entities
-void WorldSystem::handle_collisions_world()
-{
-	// Loop over all collisions detected by the physics system
-	auto &collisionsRegistry = registry.collisions;
-	for (uint i = 0; i < collisionsRegistry.components.size(); i++)
-	{
-		// The entity and its collider
-		Entity entity = collisionsRegistry.entities[i];
-		Entity entity_other = collisionsRegistry.components[i].other_entity;
-		// if (registry.players.has(entity))
-		//{
-		//	// Checking Player - Enemy collisions
-		//	if (registry.mainWorldEnemies.has(entity_other) && registry.positionKeyFrames.has(entity_other) && registry.mainWorldEnemies.size() == 1)
-		//	{
-		//		if (!registry.enterCombatTimer.has(entity))
-		//		{
-		//			registry.enterCombatTimer.emplace(entity);
-		//			registry.enterCombatTimer.get(entity).engagedEnemeis.push_back(entity_other);
-		//		} else {
-		//			std::vector<Entity> vec = registry.enterCombatTimer.get(entity).engagedEnemeis;
-		//			int find = 0;
-		//			for (unsigned int j = 0; j < vec.size(); j++) {
-		//  					if (vec[j]== entity_other) {
-		//					find = 1;
-		//					break;
-		//				}
-		//					}
-		//			if (!find) {
-		//      				registry.enterCombatTimer.get(entity).engagedEnemeis.push_back(entity_other);
-		//  				}
-		//		}
-		//	}
-		//}
-		// enemy bullet vs player bullet collision
-		if (registry.enemyBullets.has(entity) && registry.playerBullets.has(entity_other) ||
-			registry.enemyBullets.has(entity_other) && registry.playerBullets.has(entity))
-		{
-			// remove enemy upon collision
-			registry.remove_all_components_of(entity);
-			registry.remove_all_components_of(entity_other);
-		}
+// Contact reactions, entity is the one the handler is registered for and entity_other the one it touched
 
-		// player bullet vs enemy collision
-		if (registry.mainWorldEnemies.has(entity) && registry.playerBullets.has(entity_other) ||
-			registry.snipers.has(entity) && registry.playerBullets.has(entity_other) ||
-			registry.zombies.has(entity) && registry.playerBullets.has(entity_other))
-		{
-
-			// remove enemy upon collision
-			if (!registry.bosses.has(entity))
-			{
-				GenerateDropBuff(entity);
-				registry.remove_all_components_of(entity);
-				registry.remove_all_components_of(entity_other);
-			}
-			else if (registry.mainWorldEnemies.size() == 1)
-			{
-				registry.motions.get(player).velocity = vec2(0.f, 0.f);
-
-				pressedKeys.clear();
-
-				if (registry.spriteSheets.has(player))
-				{
-					SpriteSheet& spriteSheet = registry.spriteSheets.get(player);
-					RenderRequest& renderRequest = registry.renderRequests.get(player);
-					renderRequest.used_texture = spriteSheet.origin;
-					registry.spriteSheets.remove(player);
-				}
+// enemy bullet vs player bullet collision
+void WorldSystem::on_bullets_collide(Entity entity, Entity entity_other)
+{
+	// remove both bullets upon collision
+	registry.remove_all_components_of(entity);
+	registry.remove_all_components_of(entity_other);
+}
 
-				if (registry.roomLevel.get(curr_rooom).counter != 7) {
-					// Add door
-					Entity door = createDoor({ 0,0 }, { 0,0 }); //intialized below
-					Motion& door_motion = registry.motions.get(door);
-					float door_width = 50;
-					float door_height = 60;
-					door_motion.position = { window_width_px / 2.f - door_width / 2.f, door_height / 2.f };
-					door_motion.scale = { door_width, door_height };
-					door_motion.angle = 0;
-					door_motion.velocity = { 0,0 };
-					registry.colors.insert(door, { 0, 0, 0 });
-				}
+// player bullet vs enemy collision
+void WorldSystem::on_enemy_shot(Entity entity, Entity entity_other)
+{
+	// remove enemy upon collision
+	if (!registry.bosses.has(entity))
+	{
+		GenerateDropBuff(entity);
+		registry.remove_all_components_of(entity);
+		registry.remove_all_components_of(entity_other);
+	}
+	else if (registry.mainWorldEnemies.size() == 1)
+	{
+		registry.motions.get(player).velocity = vec2(0.f, 0.f);
 
-				// remove still flying projectiles
-				while (registry.enemyBullets.entities.size() > 0)
-					registry.remove_all_components_of(registry.enemyBullets.entities.back());
-				while (registry.playerBullets.entities.size() > 0)
-					registry.remove_all_components_of(registry.playerBullets.entities.back());
-
-				Enter_combat_timer += 2000.f;
-				int i = 0;
-				while (i < 5) {
-					GenerateDropBuff(entity);
-					i++;
-				}
-				registry.remove_all_components_of(entity);
-				registry.remove_all_components_of(entity_other);
-			}
-		}
+		pressedKeys.clear();
 
-		// enemyy bullet vs player collision
-		if (registry.enemyBullets.has(entity) && registry.players.has(entity_other) ||
-			registry.zombies.has(entity) && registry.players.has(entity_other))
+		if (registry.spriteSheets.has(player))
 		{
-			if (registry.enemyBullets.has(entity))
-			{
-				registry.remove_all_components_of(entity);
-				registry.players.components[0].currentHealth -= 10.f;
-			}
-			else if (registry.zombies.has(entity))
-			{
-				// registry.remove_all_components_of(entity);
-				if (spike_damage_timer <= 0.f)
-				{
-					registry.players.components[0].currentHealth -= 10.f;
-					spike_damage_timer = 1.f;
-				}
-
-			}
-			// handle damage interaction (nothing for now)
-			/*if (spike_damage_timer <= 0.f)
-			{
-				registry.players.components[0].currentHealth -= 10.f;
-				spike_damage_timer = 1.f;
-			}*/
+			SpriteSheet& spriteSheet = registry.spriteSheets.get(player);
+			RenderRequest& renderRequest = registry.renderRequests.get(player);
+			renderRequest.used_texture = spriteSheet.origin;
+			registry.spriteSheets.remove(player);
 		}
 
-		// spike collision
-		if (registry.spikes.has(entity) && registry.players.has(entity_other))
-		{
-			// handle damage interaction (nothing for now)
-			if (spike_damage_timer <= 0.f)
-			{
-				registry.players.components[0].currentHealth -= 10.f;
-				spike_damage_timer = 1.f;
-			}
+		if (registry.roomLevel.get(curr_rooom).counter != 7) {
+			// Add door
+			float door_width = 50;
+			float door_height = 60;
+			Entity door = createDoor({ window_width_px / 2.f - door_width / 2.f, door_height / 2.f }, { door_width, door_height });
+			registry.colors.insert(door, { 0, 0, 0 });
 		}
 
-		// player vs door collision
-		if (registry.doors.has(entity) && registry.players.has(entity_other)) {
-			enter_next_room();
+		// remove still flying projectiles
+		while (registry.enemyBullets.entities.size() > 0)
+			registry.remove_all_components_of(registry.enemyBullets.entities.back());
+		while (registry.playerBullets.entities.size() > 0)
+			registry.remove_all_components_of(registry.playerBullets.entities.back());
+
+		Enter_combat_timer += 2000.f;
+		int i = 0;
+		while (i < 5) {
+			GenerateDropBuff(entity);
+			i++;
 		}
+		registry.remove_all_components_of(entity);
+		registry.remove_all_components_of(entity_other);
+	}
+}
 
-		// player vs maze wall collision
-		if (registry.mazes.has(entity) && registry.players.has(entity_other)) {
-			
-			Motion& roomMotion = registry.motions.get(entity);
-			Motion& motion = registry.motions.get(entity_other);
+// enemy bullet vs player collision
+void WorldSystem::on_enemy_bullet_hit_player(Entity entity, Entity entity_other)
+{
+	registry.remove_all_components_of(entity);
+	registry.players.components[0].currentHealth -= 10.f;
+}
 
-			float mazeLeft = roomMotion.position.x - (roomMotion.scale.x / 2) - 20.f;
-			float mazeRight = roomMotion.position.x + (roomMotion.scale.x / 2) + 20.f;
-			float mazeTop = roomMotion.position.y - (roomMotion.scale.y / 2) - 20.f;
-			float mazeBottom = roomMotion.position.y + (roomMotion.scale.y / 2) + 20.f;
+// zombie vs player collision, other enemies only hurt the player in combat
+void WorldSystem::on_enemy_touch_player(Entity entity, Entity entity_other)
+{
+	if (registry.zombies.has(entity) && spike_damage_timer <= 0.f)
+	{
+		registry.players.components[0].currentHealth -= 10.f;
+		spike_damage_timer = 1.f;
+	}
+}
 
-			if (motion.position.x < mazeLeft) {
-				motion.position.x = mazeLeft;
-				motion.velocity.x = 0;
-			}
-			else if (motion.position.x > mazeRight) {
-				motion.position.x = mazeRight;
-				motion.velocity.x = 0;
-			}
+// player standing on spikes
+void WorldSystem::on_spikes_under_player()
+{
+	if (spike_damage_timer <= 0.f)
+	{
+		registry.players.components[0].currentHealth -= 10.f;
+		spike_damage_timer = 1.f;
+	}
+}
 
-			if (motion.position.y < mazeTop) {
-				motion.position.y = mazeTop;
-				motion.velocity.y = 0;
-			}
-			else if (motion.position.y > mazeBottom) {
-				motion.position.y = mazeBottom;
-				motion.velocity.y = 0;
-			}
+// player reached the door
+void WorldSystem::on_door_under_player()
+{
+	enter_next_room();
+}
+
+// Rebuilds room_tiles from the walls, spikes and doors left in the registry, call after removing any
+// of them. Creating them marks their cells already.
+void WorldSystem::bake_room_tiles()
+{
+	room_tiles.reset({ window_width_px, window_height_px });
+	auto bake = [](const std::vector<Entity>& entities, uint8_t flags) {
+		for (Entity entity : entities)
+		{
+			const Motion& motion = registry.motions.get(entity);
+			vec2 half = abs(motion.scale) / 2.f;
+			room_tiles.mark(motion.position - half, motion.position + half, flags);
 		}
+	};
+	bake(registry.mazes.entities, TILE_WALL);
+	bake(registry.spikes.entities, TILE_SPIKES);
+	bake(registry.doors.entities, TILE_DOOR);
+}
+
+// drop buff vs player collision
+void WorldSystem::on_drop_touch_player(Entity entity, Entity entity_other)
+{
+	DropBuffAdd(registry.dropBuffs.get(entity));
+	registry.remove_all_components_of(entity);
+}
+
+// Compute collisions between entities
+void WorldSystem::handle_collisions_world()
+{
+	// Reactions by the collider layers of the two entities, rows are the entity the handler is called for
+	typedef void (WorldSystem::*ContactHandler)(Entity entity, Entity entity_other);
+	static ContactHandler handlers[COLLIDER_LAYER_COUNT][COLLIDER_LAYER_COUNT] = {};
+	static bool initialized = false;
+	if (!initialized)
+	{
+		auto set = [](COLLIDER_LAYER layer, COLLIDER_LAYER other, ContactHandler handler) {
+			handlers[colliderLayerIndex(layer)][colliderLayerIndex(other)] = handler;
+		};
+		set(LAYER_ENEMY_BULLET, LAYER_PLAYER_BULLET, &WorldSystem::on_bullets_collide);
+		set(LAYER_PLAYER_BULLET, LAYER_ENEMY_BULLET, &WorldSystem::on_bullets_collide);
+		set(LAYER_ENEMY, LAYER_PLAYER_BULLET, &WorldSystem::on_enemy_shot);
+		set(LAYER_ENEMY_BULLET, LAYER_PLAYER, &WorldSystem::on_enemy_bullet_hit_player);
+		set(LAYER_ENEMY, LAYER_PLAYER, &WorldSystem::on_enemy_touch_player);
+		set(LAYER_DROP, LAYER_PLAYER, &WorldSystem::on_drop_touch_player);
+		initialized = true;
+	}
 
-		// drop buff vs player collision
-		if (registry.dropBuffs.has(entity) && registry.players.has(entity_other))
+	// Loop over all contacts detected by the physics system, each in both orientations
+	for (const Contact &contact : world_contacts)
+	{
+		Entity pair[2] = { contact.a, contact.b };
+		for (int k = 0; k < 2; k++)
 		{
-			DropBuffAdd(registry.dropBuffs.get(entity));
-			registry.remove_all_components_of(entity);
+			Entity entity = pair[k];
+			Entity entity_other = pair[1 - k];
+			// an earlier reaction may have removed either of them
+			if (!registry.colliderLayers.has(entity) || !registry.colliderLayers.has(entity_other))
+				break;
+
+			unsigned int layer = colliderLayerIndex(registry.colliderLayers.get(entity).layer);
+			unsigned int layer_other = colliderLayerIndex(registry.colliderLayers.get(entity_other).layer);
+			ContactHandler handler = handlers[layer][layer_other];
+			if (handler)
+				(this->*handler)(entity, entity_other);
 		}
 	}
 
-	// Remove all collisions from this simulation step
-	registry.collisions.clear();
+	// Remove all contacts from this simulation step
+	world_contacts.clear();
+
+	// Spikes and doors are looked up in the cells under the player, entering the next room rebuilds
+	// everything so it goes last. A contact handler above may have restarted the game or switched
+	// scenes, the player can be gone by now.
+	if (!registry.motions.has(player))
+		return;
+	const Motion& playerMotion = registry.motions.get(player);
+	vec2 half = abs(playerMotion.scale) / 2.f;
+	uint8_t tiles = room_tiles.flags_in(playerMotion.position - half, playerMotion.position + half);
+	if (tiles & TILE_SPIKES)
+		on_spikes_under_player();
+	if (tiles & TILE_DOOR)
+		on_door_under_player();
 }
 
 // generate random drop after kill enemy
@@ -80,11 +80,23 @@ private:
 	void enter_next_room();
 	void spawn_room_enemies(float elapsed_ms_since_last_update);
 	void check_room_boundary();
+	void bake_room_tiles();
 	void save_player_last_direction();
 	
 	void DropBuffAdd(DropBuff& drop);
 	void GenerateDropBuff(Entity entity);
 
+	// Reactions to world_contacts, dispatched by the collider layers in handle_collisions_world
+	void on_bullets_collide(Entity entity, Entity entity_other);
+	void on_enemy_shot(Entity entity, Entity entity_other);
+	void on_enemy_bullet_hit_player(Entity entity, Entity entity_other);
+	void on_enemy_touch_player(Entity entity, Entity entity_other);
+	void on_drop_touch_player(Entity entity, Entity entity_other);
+
+	// Reactions to the room_tiles under the player, looked up in handle_collisions_world
+	void on_spikes_under_player();
+	void on_door_under_player();
+
 	// OpenGL window handle
 	GLFWwindow* window;
 